@@ -29,7 +29,21 @@ SOURCES += src/main.cpp\
     src/controlfileeditor.cpp \
     src/menufile.cpp \
     src/menuhelp.cpp \
-    src/processdpkgdeb.cpp
+    src/jobscheduler.cpp \
+    src/nodearena.cpp \
+    src/filescanner.cpp \
+    src/internedname.cpp \
+    src/searchindex.cpp \
+    src/persistenttree.cpp \
+    src/projectfile.cpp \
+    src/projectrestorer.cpp \
+    src/journal.cpp \
+    src/blobstore.cpp \
+    src/shelllexer.cpp \
+    src/scriptlexer.cpp \
+    src/controlparser.cpp \
+    src/scriptchecker.cpp \
+    src/packagelinter.cpp
 
 HEADERS  += src/mainwindow.h \
     src/filesignatureinfo.hpp \
@@ -45,7 +59,22 @@ HEADERS  += src/mainwindow.h \
     src/controlfileeditor.h \
     src/menufile.h \
     src/menuhelp.h \
-    src/processdpkgdeb.h
+    src/jobscheduler.h \
+    src/objectpool.h \
+    src/nodearena.h \
+    src/filescanner.h \
+    src/internedname.h \
+    src/searchindex.h \
+    src/persistenttree.h \
+    src/projectfile.h \
+    src/projectrestorer.h \
+    src/journal.h \
+    src/blobstore.h \
+    src/shelllexer.h \
+    src/scriptlexer.h \
+    src/controlparser.h \
+    src/scriptchecker.h \
+    src/packagelinter.h
 
 FORMS    += mainwindow.ui
 
@@ -1,8 +1,15 @@
 #include "abstractfile.h"
+#include "folder.h"
+#include "realfile.h"
 
-AbstractFile::AbstractFile(const std::string &name, bool canRename, AbstractFile *parent)
+AbstractFile::AbstractFile(const std::string &name, Kind kind, bool canRename, AbstractFile *parent)
+    : name(name), kind(kind)
 {
-    this->name = name;
+    this->row = -1;
+    this->id = 0;
+    this->installPathValid = false;
+    this->installPathVersion = 0;
+    this->parentPathVersion = 0;
     this->parent = parent;
     this->canRename = canRename;
 }
@@ -12,9 +19,34 @@ AbstractFile::~AbstractFile()
 
 }
 
-std::string AbstractFile::getName()
+const std::string &AbstractFile::getName() const
 {
-    return this->name;
+    return this->name.str();
+}
+
+const QString &AbstractFile::getDisplayName() const
+{
+    return this->name.qstr();
+}
+
+const QString &AbstractFile::getInstallPath()
+{
+    // built from the cached path of the parent, checked up to the root,
+    // so a rename or a move only rebuilds the paths of its subtree
+    if (parent){
+        const QString &parent_path = parent->getInstallPath();
+        if (!installPathValid || parentPathVersion != parent->installPathVersion){
+            installPath = parent_path.isEmpty() ? getDisplayName() : parent_path+"/"+getDisplayName();
+            parentPathVersion = parent->installPathVersion;
+            installPathVersion++;
+            installPathValid = true;
+        }
+    } else if (!installPathValid){
+        installPath.clear();
+        installPathVersion++;
+        installPathValid = true;
+    }
+    return installPath;
 }
 
 bool AbstractFile::hasParent()
@@ -29,13 +61,23 @@ AbstractFile *AbstractFile::getParent()
 
 void AbstractFile::setParent(AbstractFile *parent)
 {
+    if (parent != this->parent)
+        installPathValid = false;
     this->parent = parent;
 }
 
 void AbstractFile::setName(const std::string &name)
 {
-    if (canRename)
-        this->name = name;
+    if (canRename && name != this->name.str()){
+        const std::string oldname = this->name.str();
+        this->name = InternedName(name);
+        // the root isn't in the paths, renaming the package keeps them
+        if (parent)
+            installPathValid = false;
+        // keep the name and path indexes of the tree up to date
+        if (parent)
+            static_cast<Folder*>(parent)->childRenamed(this, oldname);
+    }
 }
 
 void AbstractFile::setCanRename(bool canRename)
@@ -47,3 +89,45 @@ bool AbstractFile::isRenamable()
 {
     return canRename;
 }
+
+int AbstractFile::getRow() const
+{
+    return row;
+}
+
+std::uint64_t AbstractFile::getId() const
+{
+    return id;
+}
+
+AbstractFile::Kind AbstractFile::getKind() const
+{
+    return kind;
+}
+
+bool AbstractFile::isFolder() const
+{
+    return kind == FOLDER;
+}
+
+Folder *AbstractFile::toFolder()
+{
+    return kind == FOLDER ? static_cast<Folder*>(this) : nullptr;
+}
+
+RealFile *AbstractFile::toRealFile()
+{
+    return kind == REALFILE ? static_cast<RealFile*>(this) : nullptr;
+}
+
+void AbstractFile::accept(AbstractFileVisitor &visitor)
+{
+    switch (kind) {
+    case FOLDER:
+        visitor.visit(static_cast<Folder*>(this));
+        break;
+    case REALFILE:
+        visitor.visit(static_cast<RealFile*>(this));
+        break;
+    }
+}
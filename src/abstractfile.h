@@ -1,7 +1,13 @@
 #ifndef ABSTRACTFILE_H
 #define ABSTRACTFILE_H
 
+#include "internedname.h"
 #include <string>
+#include <cstdint>
+
+class Folder;
+class RealFile;
+class AbstractFileVisitor;
 
 /**
  * @brief The AbstractFile class
@@ -11,22 +17,61 @@
 
 class AbstractFile
 {
+    friend class Folder;
+    friend class NodeArena;
 
 public:
-    AbstractFile(const std::string& name, bool canRename, AbstractFile *parent = nullptr);
+    enum Kind { FOLDER=0, REALFILE };
+
+    AbstractFile(const std::string& name, Kind kind, bool canRename, AbstractFile *parent = nullptr);
     virtual ~AbstractFile() = 0;
-    std::string getName();
+    const std::string& getName() const;
+    const QString& getDisplayName() const;
+    const QString& getInstallPath();
     bool hasParent();
     AbstractFile *getParent();
     void setParent(AbstractFile *parent);
     void setName(const std::string& name);
     void setCanRename(bool canRename);
     bool isRenamable();
+    int getRow() const;
+    std::uint64_t getId() const;
+    Kind getKind() const;
+    bool isFolder() const;
+    Folder *toFolder();
+    RealFile *toRealFile();
+    void accept(AbstractFileVisitor& visitor);
 
 protected:
     AbstractFile *parent;
-    std::string name;
+    InternedName name;
     bool canRename;
+    const Kind kind;
+    // position in the parent folder, maintained by Folder
+    int row;
+    // unique in the NodeArena, kept by the snapshots of the tree
+    std::uint64_t id;
+    // path from the root, rebuilt when the node is renamed or moved,
+    // or when the path of the parent changed (another version)
+    QString installPath;
+    bool installPathValid;
+    unsigned int installPathVersion;
+    unsigned int parentPathVersion;
+};
+
+/**
+ * @brief The AbstractFileVisitor class
+ * Dispatched by AbstractFile::accept and Folder::traverse,
+ * return false from visit(Folder*) to skip the folder content
+ */
+
+class AbstractFileVisitor
+{
+
+public:
+    virtual ~AbstractFileVisitor() {}
+    virtual bool visit(Folder *folder) = 0;
+    virtual void visit(RealFile *file) = 0;
 };
 
 #endif // ABSTRACTFILE_H
@@ -0,0 +1,147 @@
+#include "blobstore.h"
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QRunnable>
+#include <QTemporaryFile>
+#include <QThreadPool>
+#ifdef Q_OS_LINUX
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#endif
+
+namespace {
+// bytes read at once when hashing or copying
+const qint64 CHUNK = 1024*1024;
+
+class IngestTask : public QRunnable
+{
+public:
+    IngestTask(const BlobStore *store, const QString &source, QString *hash)
+        : store(store), source(source), hash(hash)
+    {
+
+    }
+
+    void run()
+    {
+        *hash = store->ingest(source);
+    }
+
+private:
+    const BlobStore *store;
+    QString source;
+    QString *hash;
+};
+}
+
+BlobStore::BlobStore(const QString &dir)
+    : dir(dir)
+{
+
+}
+
+QString BlobStore::forProject(const QString &projectFile, const QString &package)
+{
+    // one store for all the project files of the package in the folder
+    return QFileInfo(projectFile).absolutePath()+"/"+package+".blobs";
+}
+
+bool BlobStore::copy(const QString &source, const QString &destination)
+{
+    bool ret = false;
+    QFile in(source);
+    QFile out(destination);
+    if (in.open(QIODevice::ReadOnly) && out.open(QIODevice::WriteOnly | QIODevice::Truncate)){
+        ret = reflink(in, out);
+        if (!ret){
+            bool ok = true;
+            while (ok && !in.atEnd()){
+                const QByteArray chunk = in.read(CHUNK);
+                ok = !chunk.isEmpty() && out.write(chunk) == chunk.size();
+            }
+            ret = ok;
+        }
+        out.close();
+    }
+    return ret;
+}
+
+const QString &BlobStore::getDir() const
+{
+    return dir;
+}
+
+QString BlobStore::pathOf(const QString &hash) const
+{
+    // two levels, a folder never holds too many files
+    return dir+"/"+hash.left(2)+"/"+hash.mid(2);
+}
+
+bool BlobStore::contains(const QString &hash) const
+{
+    return !hash.isEmpty() && QFileInfo::exists(pathOf(hash));
+}
+
+QString BlobStore::ingest(const QString &source) const
+{
+    QString ret;
+    QFile in(source);
+    QTemporaryFile out(dir+"/ingest-XXXXXX");
+    if (QDir().mkpath(dir) && in.open(QIODevice::ReadOnly) && out.open()){
+        QCryptographicHash hash(QCryptographicHash::Sha256);
+        // the hash is read from the copy, the source can change meanwhile
+        const bool shared = reflink(in, out);
+        QFile &from = shared ? static_cast<QFile&>(out) : in;
+        bool ok = from.seek(0);
+        while (ok && !from.atEnd()){
+            const QByteArray chunk = from.read(CHUNK);
+            ok = !chunk.isEmpty() && (shared || out.write(chunk) == chunk.size());
+            hash.addData(chunk);
+        }
+        if (ok && out.flush()){
+            const QString hex = hash.result().toHex();
+            const QString target = pathOf(hex);
+            if (QFileInfo::exists(target)){
+                // already stored by another file or another version
+                ret = hex;
+            } else if (QDir().mkpath(QFileInfo(target).absolutePath())){
+                out.setPermissions(QFile::ReadOwner | QFile::ReadGroup | QFile::ReadOther);
+                if (out.rename(target)){
+                    out.setAutoRemove(false);
+                    ret = hex;
+                } else if (QFileInfo::exists(target)){
+                    // the same bytes were stored by another thread
+                    ret = hex;
+                }
+            }
+        }
+    }
+    return ret;
+}
+
+QVector<QString> BlobStore::ingest(const QStringList &sources) const
+{
+    // the files are read in parallel, each task fills its own hash
+    QVector<QString> ret(sources.size());
+    QThreadPool pool;
+    for (int i=0; i<sources.size(); i++){
+        pool.start(new IngestTask(this, sources.at(i), &ret[i]));
+    }
+    pool.waitForDone();
+    return ret;
+}
+
+bool BlobStore::reflink(QFile &source, QFile &destination)
+{
+    // the destination shares the extents of the source (btrfs, xfs...)
+    bool ret = false;
+#if defined(Q_OS_LINUX) && defined(FICLONE)
+    ret = ioctl(destination.handle(), FICLONE, source.handle()) == 0;
+#else
+    Q_UNUSED(source);
+    Q_UNUSED(destination);
+#endif
+    return ret;
+}
@@ -0,0 +1,36 @@
+#ifndef BLOBSTORE_H
+#define BLOBSTORE_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+class QFile;
+
+/**
+ * @brief The BlobStore class
+ * Copies of the package files kept next to the project, each one
+ * stored once under the sha256 of its bytes and shared by all the
+ * versions of the project. The copies are reflinks when the filesystem
+ * allows it, the bytes are then shared with the source, not copied.
+ */
+
+class BlobStore
+{
+public:
+    BlobStore(const QString& dir);
+    static QString forProject(const QString& projectFile, const QString& package);
+    static bool copy(const QString& source, const QString& destination);
+    const QString& getDir() const;
+    QString pathOf(const QString& hash) const;
+    bool contains(const QString& hash) const;
+    QString ingest(const QString& source) const;
+    QVector<QString> ingest(const QStringList& sources) const;
+
+private:
+    static bool reflink(QFile& source, QFile& destination);
+    QString dir;
+
+};
+
+#endif // BLOBSTORE_H
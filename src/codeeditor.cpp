@@ -1,14 +1,20 @@
 #include "codeeditor.h"
 #include "linenumberarea.h"
+#include "syntaxhighlighter.h"
 #include <QPainter>
 #include <QTextBlock>
+#include <QHelpEvent>
+#include <QToolTip>
 #include <QSyntaxHighlighter>
 
 CodeEditor::CodeEditor(QWidget *parent)
     : QPlainTextEdit(parent)
 {
     activeHighlight = true;
+    lineHighlighted = false;
     highlighter = Q_NULLPTR;
+    gutterWidth = -1;
+    gutterBlockCount = 0;
     lineNumberArea = new LineNumberArea(this);
 
     connect(this, SIGNAL(blockCountChanged(int)), this, SLOT(updateLineNumberAreaWidth(int)));
@@ -31,16 +37,25 @@ void CodeEditor::lineNumberAreaPaintEvent(QPaintEvent *event)
 {
     QPainter painter(lineNumberArea);
     painter.fillRect(event->rect(), Qt::lightGray);
+    painter.setPen(Qt::black);
+    painter.setFont(font());
+    if (digitsFont != font())
+        prepareDigits();
+    const int digitWidth = fontMetrics().width(QLatin1Char('9'));
     QTextBlock block = firstVisibleBlock();
     int blockNumber = block.blockNumber();
     int top = (int) blockBoundingGeometry(block).translated(contentOffset()).top();
     int bottom = top + (int) blockBoundingRect(block).height();
     while (block.isValid() && top <= event->rect().bottom()){
         if (block.isVisible() && bottom >= event->rect().top()) {
-            QString number = QString::number(blockNumber + 1);
-            painter.setPen(Qt::black);
-            painter.drawText(0, top, lineNumberArea->width(), fontMetrics().height(),
-                             Qt::AlignRight, number);
+            // right aligned, from the last digit
+            int number = blockNumber + 1;
+            int x = lineNumberArea->width();
+            do {
+                x -= digitWidth;
+                painter.drawStaticText(x, top, digits[number % 10]);
+                number /= 10;
+            } while (number > 0);
         }
 
         block = block.next();
@@ -68,6 +83,7 @@ int CodeEditor::lineNumberAreaWidth()
 void CodeEditor::showLineNumber(bool print)
 {
     lineNumberArea->setVisible(print);
+    updateLineNumberAreaWidth(0);
 }
 
 void CodeEditor::showHighlightLine(bool hl)
@@ -86,6 +102,28 @@ void CodeEditor::setSyntaxHighlighter(QSyntaxHighlighter *highlighter)
     this->highlighter = highlighter;
 }
 
+void CodeEditor::setDiagnostics(const QVector<CodeEditor::Diagnostic> &diagnostics)
+{
+    diagnosticSelections.clear();
+    diagnosticMessages.clear();
+    for (const Diagnostic &diagnostic : diagnostics){
+        QTextEdit::ExtraSelection selection;
+        selection.cursor = QTextCursor(document());
+        selection.cursor.setPosition(diagnostic.position);
+        if (diagnostic.length > 0){
+            selection.cursor.setPosition(diagnostic.position+diagnostic.length, QTextCursor::KeepAnchor);
+            selection.format.setUnderlineStyle(QTextCharFormat::WaveUnderline);
+            selection.format.setUnderlineColor(Qt::red);
+        } else {
+            selection.format.setBackground(QColor(Qt::red).lighter(185));
+            selection.format.setProperty(QTextFormat::FullWidthSelection, true);
+        }
+        diagnosticSelections.append(selection);
+        diagnosticMessages.append(diagnostic.message);
+    }
+    updateExtraSelections();
+}
+
 void CodeEditor::resizeEvent(QResizeEvent *event)
 {
     QPlainTextEdit::resizeEvent(event);
@@ -93,38 +131,95 @@ void CodeEditor::resizeEvent(QResizeEvent *event)
     lineNumberArea->setGeometry(QRect(cr.left(), cr.top(), lineNumberAreaWidth(), cr.height()));
 }
 
+bool CodeEditor::viewportEvent(QEvent *event)
+{
+    bool ret;
+    if (event->type() == QEvent::ToolTip){
+        // the messages of the diagnostics under the mouse
+        QHelpEvent *help = static_cast<QHelpEvent*>(event);
+        const QTextCursor cursor = cursorForPosition(help->pos());
+        QStringList messages;
+        for (int i=0; i<diagnosticSelections.size(); i++){
+            const QTextCursor &marked = diagnosticSelections.at(i).cursor;
+            if (marked.hasSelection() ? (cursor.position() >= marked.selectionStart() && cursor.position() <= marked.selectionEnd())
+                                      : marked.blockNumber() == cursor.blockNumber())
+                messages.append(diagnosticMessages.at(i));
+        }
+        if (messages.isEmpty())
+            QToolTip::hideText();
+        else
+            QToolTip::showText(help->globalPos(), messages.join("\n"), viewport());
+        ret = true;
+    } else {
+        ret = QPlainTextEdit::viewportEvent(event);
+    }
+    return ret;
+}
+
 void CodeEditor::updateLineNumberAreaWidth(int newBlockCount)
 {
     Q_UNUSED(newBlockCount);
-    setViewportMargins(lineNumberAreaWidth(), 0, 0, 0);
+    // the viewport is laid out again only when a digit is added or removed
+    const int width = lineNumberAreaWidth();
+    if (width != gutterWidth){
+        gutterWidth = width;
+        setViewportMargins(width, 0, 0, 0);
+    }
 }
 
 void CodeEditor::highlightCurrentLine()
 {
-    QList<QTextEdit::ExtraSelection> extraSelections;
-    if (!isReadOnly()){
-        if (activeHighlight){
-            QTextEdit::ExtraSelection selection;
-
+    // the selection follows the edits of its block, it is only moved
+    // when the cursor goes to another block
+    const bool wanted = activeHighlight && !isReadOnly();
+    if (wanted != lineHighlighted || (wanted && currentLine.cursor.blockNumber() != textCursor().blockNumber())){
+        lineHighlighted = wanted;
+        if (wanted){
             QColor lineColor = QColor(Qt::blue).lighter(192);
 
-            selection.format.setBackground(lineColor);
-            selection.format.setProperty(QTextFormat::FullWidthSelection, true);
-            selection.cursor = textCursor();
-            selection.cursor.clearSelection();
-            extraSelections.append(selection);
+            currentLine.format.setBackground(lineColor);
+            currentLine.format.setProperty(QTextFormat::FullWidthSelection, true);
+            currentLine.cursor = textCursor();
+            currentLine.cursor.clearSelection();
         }
+        updateExtraSelections();
     }
-    setExtraSelections(extraSelections);
 }
 
 void CodeEditor::updateLineNumberArea(const QRect &rect, int dy)
 {
-    if (dy)
+    // the numbers only move when the lines are scrolled, added, removed or
+    // laid out again (full width), not for the cursor or a change in a line
+    if (dy){
         lineNumberArea->scroll(0, dy);
-    else
+    } else if (rect.width() >= viewport()->width() || blockCount() != gutterBlockCount){
+        gutterBlockCount = blockCount();
         lineNumberArea->update(0, rect.y(), lineNumberArea->width(), rect.height());
+    }
 
     if (rect.contains(viewport()->rect()))
         updateLineNumberAreaWidth(0);
+
+    // a large script is highlighted from what is shown
+    if (SyntaxHighLighter *sh = qobject_cast<SyntaxHighLighter*>(highlighter))
+        sh->setVisibleBlocks(firstVisibleBlock().blockNumber(), viewport()->height()/qMax(1, fontMetrics().height())+1);
+}
+
+void CodeEditor::updateExtraSelections()
+{
+    QList<QTextEdit::ExtraSelection> extraSelections;
+    if (lineHighlighted)
+        extraSelections.append(currentLine);
+    extraSelections.append(diagnosticSelections);
+    setExtraSelections(extraSelections);
+}
+
+void CodeEditor::prepareDigits()
+{
+    digitsFont = font();
+    for (int i=0; i<10; i++){
+        digits[i].setText(QString::number(i));
+        digits[i].setTextFormat(Qt::PlainText);
+        digits[i].prepare(QTransform(), digitsFont);
+    }
 }
@@ -2,12 +2,18 @@
 #define CODEEDITOR_H
 
 #include <QPlainTextEdit>
+#include <QStaticText>
+#include <QStringList>
+#include <QVector>
 
 class QSyntaxHighlighter;
 
 /**
  * @brief The CodeEditor class
  * http://doc.qt.io/qt-5/qtwidgets-widgets-codeeditor-example.html
+ * The line numbers are drawn from cached digit glyphs and the gutter
+ * is only resized or repainted when the numbers change, so the editor
+ * stays fast on a very long document.
  */
 
 class CodeEditor : public QPlainTextEdit
@@ -15,6 +21,14 @@ class CodeEditor : public QPlainTextEdit
     Q_OBJECT
 
 public:
+    // a problem in the text, underlined, the message is in the tooltip;
+    // the whole line is marked when the length is 0
+    struct Diagnostic
+    {
+        int position;
+        int length;
+        QString message;
+    };
     CodeEditor(QWidget *parent = Q_NULLPTR);
     ~CodeEditor();
     void lineNumberAreaPaintEvent(QPaintEvent *event);
@@ -22,19 +36,33 @@ public:
     void showLineNumber(bool print);
     void showHighlightLine(bool hl);
     void setSyntaxHighlighter(QSyntaxHighlighter *highlighter);
+    void setDiagnostics(const QVector<Diagnostic>& diagnostics);
 
 protected:
     void resizeEvent(QResizeEvent *event) override;
+    bool viewportEvent(QEvent *event) override;
 
 private slots:
     void updateLineNumberAreaWidth(int newBlockCount);
     void highlightCurrentLine();
     void updateLineNumberArea(const QRect &rect, int dy);
 
-private:    
+private:
+    void prepareDigits();
+    void updateExtraSelections();
     QSyntaxHighlighter *highlighter;
     QWidget *lineNumberArea;
     bool activeHighlight;
+    bool lineHighlighted;
+    QTextEdit::ExtraSelection currentLine;
+    // the cursors follow the edits until the diagnostics are set again
+    QList<QTextEdit::ExtraSelection> diagnosticSelections;
+    QStringList diagnosticMessages;
+    // one glyph per digit, laid out for digitsFont
+    QStaticText digits[10];
+    QFont digitsFont;
+    int gutterWidth;
+    int gutterBlockCount;
 
 };
 
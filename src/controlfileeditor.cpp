@@ -2,13 +2,25 @@
 #include "syntaxhighlighter.h"
 #include <QTextBlock>
 #include <QRegularExpression>
+#include <QTimer>
+
+namespace {
+// time without typing before the changes are sent
+const int NOTIFY_DELAY = 300;
+}
 
 ControlFileEditor::ControlFileEditor(QWidget *parent)
     : CodeEditor(parent)
 {
     packageName = "packagename";
     version = "1.0";
-    connect(this, SIGNAL(textChanged()), this, SLOT(infoIsEdited()));
+    notifiedPackageName = packageName;
+    notifiedVersion = version;
+    notifyTimer = new QTimer(this);
+    notifyTimer->setSingleShot(true);
+    notifyTimer->setInterval(NOTIFY_DELAY);
+    connect(notifyTimer, SIGNAL(timeout()), this, SLOT(notifyChanges()));
+    connect(document(), SIGNAL(contentsChange(int,int,int)), this, SLOT(infoIsEdited(int,int,int)));
     showLineNumber(false);
     showHighlightLine(false);
 
@@ -33,28 +45,70 @@ QString ControlFileEditor::getVersion() const
 void ControlFileEditor::setPackageName(const QString &pname)
 {
     packageName = pname;
+    notifiedPackageName = pname;
     emit packageNameChanged(packageName);
 }
 
 void ControlFileEditor::setVersion(const QString &v)
 {
     version = v;
+    notifiedVersion = v;
     emit versionChanged(version);
 }
 
-void ControlFileEditor::infoIsEdited()
+const ControlParser &ControlFileEditor::getParser() const
+{
+    return parser;
+}
+
+void ControlFileEditor::infoIsEdited(int position, int removed, int added)
+{
+    Q_UNUSED(removed);
+    // only the lines of the change
+    QTextBlock block = document()->findBlock(position);
+    QTextBlock last = document()->findBlock(position+added);
+    if (!last.isValid())
+        last = document()->lastBlock();
+    const QTextBlock end = last.next();
+    while (block.isValid() && block != end){
+        parseLine(block.text());
+        block = block.next();
+    }
+    // the text is checked and the tree renamed once the typing pauses
+    notifyTimer->start();
+}
+
+void ControlFileEditor::notifyChanges()
+{
+    notifyTimer->stop();
+    parser = ControlParser(toPlainText());
+    QVector<Diagnostic> diagnostics;
+    for (const ControlParser::Diagnostic &d : parser.getDiagnostics()){
+        Diagnostic diagnostic;
+        diagnostic.position = d.position;
+        diagnostic.length = d.length;
+        diagnostic.message = d.message;
+        diagnostics.append(diagnostic);
+    }
+    setDiagnostics(diagnostics);
+    if (packageName != notifiedPackageName){
+        notifiedPackageName = packageName;
+        emit packageNameChanged(packageName);
+    }
+    if (version != notifiedVersion){
+        notifiedVersion = version;
+        emit versionChanged(version);
+    }
+}
+
+void ControlFileEditor::parseLine(const QString &line)
 {
-    QTextBlock txtBlock = document()->findBlockByNumber(textCursor().blockNumber());
-    QString curLine = txtBlock.text();
-    QRegularExpression regex("^(?<info>Package|Version):\\s?(?<value>.*)$");
-    QRegularExpressionMatch rem = regex.match(curLine);
+    static const QRegularExpression regex("^(?<info>Package|Version):\\s?(?<value>.*)$");
+    QRegularExpressionMatch rem = regex.match(line);
     if (rem.hasMatch()){
-        if ("Package" == rem.captured("info")){
+        if ("Package" == rem.captured("info"))
             packageName = rem.captured("value");
-            emit packageNameChanged(rem.captured("value"));
-        } else {
+        else
             version = rem.captured("value");
-            emit versionChanged(rem.captured("value"));
-        }
     }
 }
@@ -2,10 +2,16 @@
 #define CONTROLFILEEDITOR_H
 
 #include "codeeditor.h"
+#include "controlparser.h"
+
+class QTimer;
 
 /**
  * @brief The ControlFileEditor class
- * A specialization of the CodeEdit for the control file
+ * A specialization of the CodeEdit for the control file.
+ * Only the changed lines are parsed, the changes of the package name
+ * and version are sent once the typing pauses. The whole text is then
+ * checked by the ControlParser and its diagnostics are shown.
  */
 
 class ControlFileEditor : public CodeEditor
@@ -18,17 +24,27 @@ public:
     QString getVersion() const;
     void setPackageName(const QString& pname);
     void setVersion(const QString& v);
+    // the text as of the last notifyChanges
+    const ControlParser &getParser() const;
 
 public slots:
-    void infoIsEdited();
+    void infoIsEdited(int position, int removed, int added);
+    // check the text and send the changes waiting for the end of the typing
+    void notifyChanges();
 
 signals:
     void packageNameChanged(const QString &pname);
     void versionChanged(const QString &version);
 
 private:
+    void parseLine(const QString& line);
     QString packageName;
     QString version;
+    // the values last sent
+    QString notifiedPackageName;
+    QString notifiedVersion;
+    QTimer *notifyTimer;
+    ControlParser parser;
 
 };
 
@@ -0,0 +1,234 @@
+#include "controlparser.h"
+
+namespace {
+// the fields dpkg-deb wants in a binary package
+const char *const REQUIRED_FIELDS[] = {"Package", "Version", "Architecture", "Maintainer", "Description"};
+// the values of these ones are on a single line
+const char *const SIMPLE_FIELDS[] = {"Package", "Version", "Architecture"};
+
+bool isBlank(const QStringRef &line)
+{
+    bool ret = true;
+    for (int i=0; i<line.size() && ret; i++){
+        ret = line.at(i) == ' ' || line.at(i) == '\t';
+    }
+    return ret;
+}
+
+bool isNameChar(QChar c)
+{
+    // printable US-ASCII, without the space and the colon
+    return c.unicode() > ' ' && c.unicode() < 127 && c != ':';
+}
+
+bool isLowerAlnum(QChar c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9');
+}
+
+bool isAlnum(QChar c)
+{
+    return isLowerAlnum(c) || (c >= 'A' && c <= 'Z');
+}
+}
+
+ControlParser::ControlParser(const QString &text)
+    : text(text)
+{
+    parse();
+    validate();
+}
+
+const QVector<ControlParser::Field> &ControlParser::getFields() const
+{
+    return fields;
+}
+
+const QVector<ControlParser::Diagnostic> &ControlParser::getDiagnostics() const
+{
+    return diagnostics;
+}
+
+bool ControlParser::isValid() const
+{
+    return diagnostics.isEmpty();
+}
+
+QStringRef ControlParser::name(const ControlParser::Field &field) const
+{
+    return text.midRef(field.start, field.nameLength);
+}
+
+QStringRef ControlParser::value(const ControlParser::Field &field) const
+{
+    return text.midRef(field.valueStart, field.end-field.valueStart);
+}
+
+QStringRef ControlParser::value(const QString &name) const
+{
+    const Field *field = find(name);
+    return field ? value(*field) : QStringRef();
+}
+
+const ControlParser::Field *ControlParser::find(const QString &name) const
+{
+    return find(QStringRef(&name));
+}
+
+const ControlParser::Field *ControlParser::find(const QStringRef &name) const
+{
+    // the names are not case sensitive
+    const Field *ret = Q_NULLPTR;
+    for (int i=0; i<fields.size() && !ret; i++){
+        if (this->name(fields.at(i)).compare(name, Qt::CaseInsensitive) == 0)
+            ret = &fields.at(i);
+    }
+    return ret;
+}
+
+QString ControlParser::toControl() const
+{
+    int size = 0;
+    for (const Line &line : lines){
+        size += line.length+1;
+    }
+    QString ret;
+    ret.reserve(size);
+    for (const Line &line : lines){
+        ret.append(text.midRef(line.start, line.length));
+        ret.append('\n');
+    }
+    return ret;
+}
+
+bool ControlParser::isValidPackageName(const QStringRef &name)
+{
+    // at least two characters: a-z 0-9 + - . starting with a letter or a digit
+    bool ret = name.size() >= 2 && isLowerAlnum(name.at(0));
+    for (int i=1; i<name.size() && ret; i++){
+        const QChar c = name.at(i);
+        ret = isLowerAlnum(c) || c == '+' || c == '-' || c == '.';
+    }
+    return ret;
+}
+
+bool ControlParser::isValidVersion(const QStringRef &version)
+{
+    // [epoch:]upstream[-revision], the revision is after the last hyphen
+    bool ret = !version.isEmpty();
+    QStringRef rest = version;
+    const int colon = version.indexOf(':');
+    if (colon != -1){
+        ret = colon > 0;
+        for (int i=0; i<colon && ret; i++){
+            ret = version.at(i) >= '0' && version.at(i) <= '9';
+        }
+        rest = version.mid(colon+1);
+    }
+    const int hyphen = rest.lastIndexOf('-');
+    const QStringRef upstream = hyphen == -1 ? rest : rest.left(hyphen);
+    ret = ret && !upstream.isEmpty() && upstream.at(0) >= '0' && upstream.at(0) <= '9';
+    for (int i=1; i<upstream.size() && ret; i++){
+        const QChar c = upstream.at(i);
+        ret = isAlnum(c) || c == '.' || c == '+' || c == '~' || c == '-';
+    }
+    if (hyphen != -1){
+        const QStringRef revision = rest.mid(hyphen+1);
+        ret = ret && !revision.isEmpty();
+        for (int i=0; i<revision.size() && ret; i++){
+            const QChar c = revision.at(i);
+            ret = isAlnum(c) || c == '.' || c == '+' || c == '~';
+        }
+    }
+    return ret;
+}
+
+void ControlParser::parse()
+{
+    const int n = text.size();
+    // the field the continuation lines go to, -1 if none
+    int current = -1;
+    bool paragraphEnded = false;
+    int pos = 0;
+    while (pos < n){
+        int end = text.indexOf('\n', pos);
+        if (end == -1)
+            end = n;
+        const QStringRef line = text.midRef(pos, end-pos);
+        if (line.startsWith('#')){
+            // a comment, even between the lines of a field
+        } else if (isBlank(line)){
+            paragraphEnded = !fields.isEmpty();
+            current = -1;
+        } else if (line.at(0) == ' ' || line.at(0) == '\t'){
+            if (current == -1){
+                addDiagnostic(pos, line.size(), "A continuation line must follow a field");
+            } else {
+                fields[current].end = end;
+                lines.append(Line{pos, line.size()});
+            }
+        } else {
+            const int colon = line.indexOf(':');
+            int nameLength = 0;
+            while (nameLength < line.size() && isNameChar(line.at(nameLength))){
+                nameLength++;
+            }
+            current = -1;
+            if (colon == -1){
+                addDiagnostic(pos, line.size(), "Missing ':' after the field name");
+            } else if (colon == 0 || nameLength != colon || line.at(0) == '-'){
+                addDiagnostic(pos, colon, "Invalid field name");
+            } else {
+                if (paragraphEnded)
+                    addDiagnostic(pos, colon, "A binary control file has a single paragraph, remove the blank line before");
+                else if (find(line.left(colon)))
+                    addDiagnostic(pos, colon, QString("Duplicate field %1").arg(line.left(colon).toString()));
+                Field field;
+                field.start = pos;
+                field.nameLength = colon;
+                field.valueStart = pos+colon+1;
+                while (field.valueStart < end && (text.at(field.valueStart) == ' ' || text.at(field.valueStart) == '\t')){
+                    field.valueStart++;
+                }
+                field.end = end;
+                fields.append(field);
+                lines.append(Line{pos, line.size()});
+                current = fields.size()-1;
+            }
+        }
+        pos = end+1;
+    }
+}
+
+void ControlParser::validate()
+{
+    for (const char *name : REQUIRED_FIELDS){
+        const Field *field = find(QString(name));
+        if (!field)
+            addDiagnostic(0, 0, QString("Missing field %1").arg(name));
+        else if (value(*field).trimmed().isEmpty())
+            addDiagnostic(field->start, field->nameLength, QString("Empty field %1").arg(name));
+    }
+    for (const char *name : SIMPLE_FIELDS){
+        const Field *field = find(QString(name));
+        if (field && value(*field).contains('\n'))
+            addDiagnostic(field->valueStart, field->end-field->valueStart, QString("%1 must be on a single line").arg(name));
+    }
+    const Field *package = find(QString("Package"));
+    if (package && !value(*package).trimmed().isEmpty() && !isValidPackageName(value(*package).trimmed()))
+        addDiagnostic(package->valueStart, package->end-package->valueStart,
+                      "Invalid package name: at least two characters among a-z 0-9 + - . starting with a letter or a digit");
+    const Field *version = find(QString("Version"));
+    if (version && !value(*version).trimmed().isEmpty() && !isValidVersion(value(*version).trimmed()))
+        addDiagnostic(version->valueStart, version->end-version->valueStart,
+                      "Invalid version: [epoch:]upstream[-revision], the upstream version starts with a digit");
+}
+
+void ControlParser::addDiagnostic(int position, int length, const QString &message)
+{
+    Diagnostic diagnostic;
+    diagnostic.position = position;
+    diagnostic.length = length;
+    diagnostic.message = message;
+    diagnostics.append(diagnostic);
+}
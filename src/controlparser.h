@@ -0,0 +1,67 @@
+#ifndef CONTROLPARSER_H
+#define CONTROLPARSER_H
+
+#include <QString>
+#include <QStringRef>
+#include <QVector>
+
+/**
+ * @brief The ControlParser class
+ * Parse and check the deb822 text of a binary control file. The fields
+ * are kept as positions in the text, nothing is copied; the comments are
+ * left out of the control written in the package.
+ */
+
+class ControlParser
+{
+public:
+    struct Field
+    {
+        // position of the name, of the value after the colon and the
+        // spaces, end of the last continuation line
+        int start;
+        int nameLength;
+        int valueStart;
+        int end;
+    };
+    struct Diagnostic
+    {
+        int position;
+        int length;
+        QString message;
+    };
+    ControlParser(const QString& text = QString());
+    const QVector<Field> &getFields() const;
+    const QVector<Diagnostic> &getDiagnostics() const;
+    bool isValid() const;
+    QStringRef name(const Field& field) const;
+    // the continuation lines are in the value with their leading space
+    QStringRef value(const Field& field) const;
+    // the value of the first field with this name, null if there is none
+    QStringRef value(const QString& name) const;
+    const Field *find(const QString& name) const;
+    // the text for DEBIAN/control, one paragraph without the comments
+    QString toControl() const;
+
+    static bool isValidPackageName(const QStringRef& name);
+    static bool isValidVersion(const QStringRef& version);
+
+private:
+    struct Line
+    {
+        int start;
+        int length;
+    };
+    const Field *find(const QStringRef& name) const;
+    void parse();
+    void validate();
+    void addDiagnostic(int position, int length, const QString& message);
+    QString text;
+    QVector<Field> fields;
+    // the lines of the fields, the comments and the blank lines are not in
+    QVector<Line> lines;
+    QVector<Diagnostic> diagnostics;
+
+};
+
+#endif // CONTROLPARSER_H
@@ -0,0 +1,71 @@
+#include "filescanner.h"
+#include "treepackagedragdropmodel.h"
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QDateTime>
+
+namespace {
+// send the results at least every BATCH_SIZE files or BATCH_DELAY ms
+const int BATCH_SIZE = 2000;
+const qint64 BATCH_DELAY = 100;
+}
+
+FileScanner::FileScanner(int scan, const QStringList &paths, quint64 target, const QString &packageName, QObject *parent)
+    : QThread(parent)
+{
+    this->scan = scan;
+    this->paths = paths;
+    this->target = target;
+    this->packageName = packageName;
+    lastFlush = 0;
+}
+
+FileScanner::~FileScanner()
+{
+    requestInterruption();
+    wait();
+}
+
+void FileScanner::run()
+{
+    lastFlush = QDateTime::currentMSecsSinceEpoch();
+    for (int i=0; i<paths.size() && !isInterruptionRequested(); i++){
+        const QFileInfo root(paths.at(i));
+        if (root.isFile()){
+            found(root.filePath(), true);
+        } else if (root.isDir()){
+            QDir base = root.dir();
+            QDirIterator it(root.filePath(), QDir::Files | QDir::Hidden | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
+            while (it.hasNext() && !isInterruptionRequested()){
+                const QString path = it.next();
+                // "dropped_dir/sub/dir" under the target folder
+                found(path, false, base.relativeFilePath(it.fileInfo().path()));
+            }
+        }
+    }
+    if (!isInterruptionRequested())
+        flush();
+}
+
+void FileScanner::found(const QString &path, bool classify, const QString &folder)
+{
+    ScannedFile sf;
+    sf.info.set_file(path.toStdString());
+    // the classified files go to a folder of the package
+    sf.target = classify ? 0 : target;
+    sf.folder = classify ? TreePackageDragDropModel::destinationFolder(sf.info, packageName) : folder;
+    batch.append(sf);
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    if (batch.size() >= BATCH_SIZE || now-lastFlush >= BATCH_DELAY){
+        flush();
+        lastFlush = now;
+    }
+}
+
+void FileScanner::flush()
+{
+    if (!batch.isEmpty()){
+        emit filesFound(scan, batch);
+        batch.clear();
+    }
+}
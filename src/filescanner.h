@@ -0,0 +1,59 @@
+#ifndef FILESCANNER_H
+#define FILESCANNER_H
+
+#include "filesignatureinfo.hpp"
+#include <QThread>
+#include <QStringList>
+#include <QVector>
+#include <QMetaType>
+
+/**
+ * @brief The ScannedFile struct
+ * A file found by the FileScanner and the package folder it goes to,
+ * the folder path is relative to the target folder, given by its id
+ */
+
+struct ScannedFile
+{
+    // 0 for the root
+    quint64 target;
+    QString folder;
+    FileSignatureInfo info;
+};
+
+Q_DECLARE_METATYPE(ScannedFile)
+
+/**
+ * @brief The FileScanner class
+ * Read the signature of the dropped files and the content of the
+ * dropped directories in background, the results are sent by batches.
+ * The files are classified by type, the directories keep their
+ * structure under the target folder.
+ */
+
+class FileScanner : public QThread
+{
+    Q_OBJECT
+public:
+    FileScanner(int scan, const QStringList& paths, quint64 target, const QString& packageName, QObject *parent = Q_NULLPTR);
+    ~FileScanner();
+
+signals:
+    void filesFound(int scan, const QVector<ScannedFile> &files);
+
+protected:
+    virtual void run();
+
+private:
+    void found(const QString& path, bool classify, const QString& folder = QString());
+    void flush();
+    int scan;
+    QStringList paths;
+    quint64 target;
+    QString packageName;
+    QVector<ScannedFile> batch;
+    qint64 lastFlush;
+
+};
+
+#endif // FILESCANNER_H
@@ -27,11 +27,38 @@ std::map<std::string, std::tuple<FileSignatureInfo::Category, std::string, std::
     {"7f454c46",          std::tuple<FileSignatureInfo::Category, std::string, std::string, std::string>(FileSignatureInfo::BINARY, "", "Executable and Linkable Format", ".ELF")}
 };
 
+FileSignatureInfo::FileSignatureInfo()
+{
+    this->extension = this->hex_signature = this->description = this->iso_8859_1 = "?";
+    this->category = INEXISTANT;
+    this->size = 0;
+}
+
 FileSignatureInfo::FileSignatureInfo(std::string path)
 {
     set_file(path);
 }
 
+FileSignatureInfo::FileSignatureInfo(std::string path, std::string hex_signature, Category category, long long size)
+{
+    // from a saved project, the file isn't read again
+    this->path = path;
+    this->hex_signature = hex_signature;
+    this->category = category;
+    this->size = size;
+    this->extension = this->iso_8859_1 = "?";
+    auto it = FileSignatureInfo::tab_info.find(hex_signature);
+    if (it != FileSignatureInfo::tab_info.end()){
+        this->extension = std::get<1>(it->second);
+        this->description = std::get<2>(it->second);
+        this->iso_8859_1 = std::get<3>(it->second);
+    } else if (category == INEXISTANT){
+        this->description = "Can't open file";
+    } else {
+        this->description = "Unrecognized signature or plain text file";
+    }
+}
+
 FileSignatureInfo::~FileSignatureInfo()
 {
 
@@ -42,6 +69,8 @@ void FileSignatureInfo::set_file(std::string path)
     this->path = path;
     this->extension = this->hex_signature = this->description = this->iso_8859_1 = "?";
     this->category = UNKNOW;
+    this->size = 0;
+    this->content.clear();
     std::ifstream file(path, std::ios::binary);
     if (file.is_open()){
         //file >> std::noskipws;
@@ -52,6 +81,9 @@ void FileSignatureInfo::set_file(std::string path)
             s << std::setfill('0') << std::setw(2) << std::hex << (int)c;
             nhex++;
         }
+        file.clear();
+        file.seekg(0, std::ios::end);
+        this->size = file.tellg();
         file.close();
         this->hex_signature = s.str();
         find_info();
@@ -91,27 +123,49 @@ FileSignatureInfo::Category FileSignatureInfo::getCategory()
     return this->category;
 }
 
+long long FileSignatureInfo::getSize()
+{
+    return this->size;
+}
+
+std::string FileSignatureInfo::getContent()
+{
+    return this->content;
+}
+
+void FileSignatureInfo::setContent(std::string content)
+{
+    this->content = content;
+}
+
 QIcon FileSignatureInfo::getIcon()
 {
+    // loaded once, the model asks them on each repaint
+    static const QIcon binary("://icon/binary.png");
+    static const QIcon audio("://icon/audio.png");
+    static const QIcon package("://icon/package.png");
+    static const QIcon image("://icon/image.png");
+    static const QIcon archive("://icon/archive.png");
+    static const QIcon file("://icon/file.png");
     QIcon ret;
     switch (getCategory()) {
     case BINARY:
-        ret = QIcon("://icon/binary.png");
+        ret = binary;
         break;
     case AUDIO:
-        ret = QIcon("://icon/audio.png");
+        ret = audio;
         break;
     case PACKAGE:
-        ret = QIcon("://icon/package.png");
+        ret = package;
         break;
     case IMAGE:
-        ret = QIcon("://icon/image.png");
+        ret = image;
         break;
     case ARCHIVE:
-        ret = QIcon("://icon/archive.png");
+        ret = archive;
         break;
     default:
-        ret = QIcon("://icon/file.png");
+        ret = file;
         break;
     }
     return ret;
@@ -18,9 +18,12 @@ class FileSignatureInfo
 {
 
 public:
+  enum Category { UNKNOW=0, BINARY, IMAGE, TEXT, AUDIO, PACKAGE, ARCHIVE, INEXISTANT };
+
+  FileSignatureInfo ();
   FileSignatureInfo (std::string path);
+  FileSignatureInfo (std::string path, std::string hex_signature, Category category, long long size);
   virtual ~FileSignatureInfo ();
-  enum Category { UNKNOW=0, BINARY, IMAGE, TEXT, AUDIO, PACKAGE, ARCHIVE, INEXISTANT };
 
   void set_file(std::string path);
 
@@ -31,6 +34,9 @@ public:
   std::string getIso_8859_1();
   std::string to_string();
   Category getCategory();
+  long long getSize();
+  std::string getContent();
+  void setContent(std::string content);
   QIcon getIcon();
   friend std::ostream& operator<<(std::ostream& os, FileSignatureInfo& obj);
 
@@ -43,6 +49,9 @@ private:
   std::string description;
   std::string iso_8859_1;
   Category category;
+  long long size;
+  // sha256 of the copy kept in the BlobStore, empty if not stored
+  std::string content;
 
   void find_info();
 
@@ -1,123 +1,297 @@
 #include "folder.h"
 #include "realfile.h"
-#include <algorithm>
 
 Folder::Folder(const std::string &name, bool canRename)
-    : AbstractFile(name, canRename)
+    : AbstractFile(name, FOLDER, canRename)
 {
+    fileCount = 0;
+    folderCount = 0;
+    size = 0;
 
 }
 
 Folder::~Folder()
 {
-    for (AbstractFile *af : tree)
-        delete af;
+    // the content is owned and released by the NodeArena
     tree.clear();
 }
 
 Folder& Folder::add(Folder *file)
 {
     file->setParent(this);
+    file->row = tree.size();
     tree.push_back(file);
+    folders.emplace(file->getName(), file);
+    // the root index of the added folder is now handled by our root
+    file->paths.clear();
+    file->folderNames.clear();
+    updateCounters(file, 1);
+    Folder *r = root();
+    const std::string parent_path = r->pathOf(this);
+    r->indexSubtree(file, parent_path.empty() ? file->getName() : parent_path+"/"+file->getName(), true);
     return (*file);
 }
 
 void Folder::add(RealFile *file)
 {
     file->setParent(this);
+    file->row = tree.size();
     tree.push_back(file);
+    files.emplace(file->getName(), file);
+    updateCounters(file, 1);
+    Folder *r = root();
+    const std::string parent_path = r->pathOf(this);
+    r->indexSubtree(file, parent_path.empty() ? file->getName() : parent_path+"/"+file->getName(), true);
 }
 
 int Folder::count(bool recursive)
 {
-    int ret = tree.size();
-    if (recursive){
-        for (AbstractFile *af : tree){
-            if(Folder* f = dynamic_cast<Folder*>(af)) {
-               ret += f->count(recursive);
-            }
-        }
-    }
-    return ret;
+    return recursive ? fileCount+folderCount : tree.size();
+}
+
+int Folder::countFiles() const
+{
+    return fileCount;
+}
+
+int Folder::countFolders() const
+{
+    return folderCount;
+}
+
+long long Folder::getSize() const
+{
+    return size;
 }
 
 Folder *Folder::containFolder(const std::string &name, bool recursive)
 {
-    Folder *ret = nullptr;
-    for (AbstractFile *af : tree){
-        if(Folder* f = dynamic_cast<Folder*>(af)) {
-           if (name == f->getName())
-               ret = f;
-           if (!ret && recursive)
-               ret = f->containFolder(name, recursive);
+    Folder *ret = getChild<Folder*>(name);
+    if (!ret && recursive){
+        Folder *r = root();
+        auto range = r->folderNames.equal_range(name);
+        for (auto it = range.first; it != range.second && !ret; it++){
+            if (it->second != this && isAncestorOf(it->second))
+                ret = it->second;
         }
-        if (ret)
-            break;
     }
     return ret;
 }
 
 RealFile *Folder::containFile(const std::string &name)
 {
-    RealFile *ret = nullptr;
-    for (AbstractFile *af : tree){
-        if(RealFile* f = dynamic_cast<RealFile*>(af)) {
-           if (name == f->getName())
-               ret = f;
-        }
-        if (ret)
-            break;
+    return getChild<RealFile*>(name);
+}
+
+AbstractFile *Folder::child(int row)
+{
+    return tree.at(row);
+}
+
+int Folder::child(AbstractFile *af)
+{
+    return af->getParent() == this ? af->row : -1;
+}
+
+bool Folder::remove(AbstractFile *afile, bool recursive)
+{
+    bool ret = false;
+    if (afile->getParent() == this){
+        Folder *r = root();
+        r->indexSubtree(afile, r->pathOf(afile), false);
+        unindexChild(afile, afile->getName());
+        updateCounters(afile, -1);
+        tree.erase(tree.begin()+afile->row);
+        for (size_t i=afile->row; i<tree.size(); i++)
+            tree[i]->row = i;
+        afile->setParent(nullptr);
+        afile->row = -1;
+        ret = true;
+    } else if (recursive && isAncestorOf(afile)){
+        ret = static_cast<Folder*>(afile->getParent())->remove(afile, false);
     }
     return ret;
 }
 
-void Folder::renameFolder(const std::string &oldname, const std::string &name, bool recursive)
+AbstractFile *Folder::find(const std::string &path)
 {
-    if (oldname == getName())
-        setName(name);
-    if (recursive){
-        for (AbstractFile *af : tree){
-            if(Folder* f = dynamic_cast<Folder*>(af)) {
-               if (f->containFolder(oldname, recursive))
-                   f->renameFolder(oldname, name, recursive);
-               else if (oldname == f->getName())
-                   f->renameFolder(oldname, name, false);
-            }
+    AbstractFile *ret = nullptr;
+    if (path.empty()){
+        ret = this;
+    } else {
+        Folder *r = root();
+        const std::string full_path = (r == this) ? path : r->pathOf(this)+"/"+path;
+        auto it = r->paths.find(full_path);
+        if (it != r->paths.end())
+            ret = it->second;
+    }
+    return ret;
+}
+
+Folder *Folder::findFolder(const std::string &path)
+{
+    AbstractFile *af = find(path);
+    return af ? af->toFolder() : nullptr;
+}
+
+Folder *Folder::root()
+{
+    AbstractFile *ret = this;
+    while (ret->hasParent())
+        ret = ret->getParent();
+    return static_cast<Folder*>(ret);
+}
+
+bool Folder::isAncestorOf(AbstractFile *af)
+{
+    bool ret = false;
+    AbstractFile *parent = af->getParent();
+    while (parent && !ret){
+        ret = (parent == this);
+        parent = parent->getParent();
+    }
+    return ret;
+}
+
+std::string Folder::pathOf(AbstractFile *af)
+{
+    std::string ret;
+    while (af && af != this){
+        ret = ret.empty() ? af->getName() : af->getName()+"/"+ret;
+        af = af->getParent();
+    }
+    return ret;
+}
+
+void Folder::childRenamed(AbstractFile *af, const std::string &oldname)
+{
+    unindexChild(af, oldname);
+    if (Folder *f = af->toFolder())
+        folders.emplace(f->getName(), f);
+    else
+        files.emplace(af->getName(), af->toRealFile());
+    // all the paths under the renamed node change
+    Folder *r = root();
+    const std::string parent_path = r->pathOf(this);
+    const std::string prefix = parent_path.empty() ? "" : parent_path+"/";
+    r->indexSubtree(af, prefix+oldname, false);
+    r->indexSubtree(af, prefix+af->getName(), true);
+}
+
+void Folder::traverse(AbstractFileVisitor &visitor)
+{
+    // iterative pre-order walk of the content, in row order
+    std::vector<AbstractFile*> stack(tree.rbegin(), tree.rend());
+    while (!stack.empty()){
+        AbstractFile *af = stack.back();
+        stack.pop_back();
+        if (Folder *f = af->toFolder()){
+            if (visitor.visit(f))
+                stack.insert(stack.end(), f->tree.rbegin(), f->tree.rend());
+        } else {
+            visitor.visit(af->toRealFile());
         }
     }
 }
 
-AbstractFile *Folder::child(int row)
+template<>
+Folder *Folder::getChild<Folder*>(const std::string &name)
 {
-    return tree.at(row);
+    auto it = folders.find(name);
+    return it != folders.end() ? it->second : nullptr;
 }
 
-int Folder::child(AbstractFile *af)
+template<>
+RealFile *Folder::getChild<RealFile*>(const std::string &name)
+{
+    auto it = files.find(name);
+    return it != files.end() ? it->second : nullptr;
+}
+
+void Folder::indexSubtree(AbstractFile *af, const std::string &path, bool insert)
 {
-    int ret = -1;
-    for (int i=0; i<tree.size() && ret==-1; i++){
-        if (tree[i] == af){
-            ret = i;
+    // iterative walk, deep trees must not overflow the stack
+    std::vector<std::pair<AbstractFile*, std::string> > stack;
+    stack.push_back(std::make_pair(af, path));
+    while (!stack.empty()){
+        AbstractFile *current = stack.back().first;
+        const std::string current_path = stack.back().second;
+        stack.pop_back();
+        // the last segment, it's still the old name of a renamed node
+        const std::string name = current_path.substr(current_path.rfind('/')+1);
+        Folder *f = current->toFolder();
+        if (insert){
+            paths[current_path] = current;
+            if (f)
+                folderNames.emplace(name, f);
+        } else {
+            auto it = paths.find(current_path);
+            if (it != paths.end() && it->second == current)
+                paths.erase(it);
+            if (f){
+                auto range = folderNames.equal_range(name);
+                for (auto itn = range.first; itn != range.second; itn++){
+                    if (itn->second == f){
+                        folderNames.erase(itn);
+                        break;
+                    }
+                }
+            }
+        }
+        if (f){
+            for (AbstractFile *c : f->tree)
+                stack.push_back(std::make_pair(c, current_path+"/"+c->getName()));
         }
     }
-    return ret;
 }
 
-bool Folder::remove(AbstractFile *afile, bool recursive)
+void Folder::unindexChild(AbstractFile *af, const std::string &name)
 {
-    bool ret = false;
-    auto it = std::find(tree.begin(), tree.end(), afile);
-    if (it != tree.end()){
-        tree.erase(it);
-        ret = true;
+    auto itf = folders.find(name);
+    if (itf != folders.end() && itf->second == af){
+        folders.erase(itf);
+        // a sibling may have the same name, index it instead
+        for (AbstractFile *c : tree){
+            Folder *f = c->toFolder();
+            if (f && c != af && c->getName() == name){
+                folders.emplace(name, f);
+                break;
+            }
+        }
     }
-    if (recursive && !ret){
-        for (AbstractFile *af : tree){
-            if(Folder* f = dynamic_cast<Folder*>(af)) {
-               ret = f->remove(afile, recursive);
+    auto itr = files.find(name);
+    if (itr != files.end() && itr->second == af){
+        files.erase(itr);
+        for (AbstractFile *c : tree){
+            RealFile *rf = c->toRealFile();
+            if (rf && c != af && c->getName() == name){
+                files.emplace(name, rf);
+                break;
             }
         }
     }
-    return ret;
 }
 
+void Folder::updateCounters(AbstractFile *af, int sign)
+{
+    // the content of af is added to (or removed from) all our ancestors
+    int files = 0;
+    int folders = 0;
+    long long bytes = 0;
+    if (Folder *f = af->toFolder()){
+        files = f->fileCount;
+        folders = f->folderCount+1;
+        bytes = f->size;
+    } else {
+        files = 1;
+        bytes = af->toRealFile()->getSize();
+    }
+    AbstractFile *current = this;
+    while (current){
+        Folder *f = static_cast<Folder*>(current);
+        f->fileCount += sign*files;
+        f->folderCount += sign*folders;
+        f->size += sign*bytes;
+        current = current->getParent();
+    }
+}
@@ -3,12 +3,18 @@
 
 #include "abstractfile.h"
 #include <vector>
+#include <unordered_map>
 
 class RealFile;
 
 /**
  * @brief The Folder class
  * Sepcialization of the AbstractFile to manage folder
+ * Children are indexed by name, and the root folder keeps
+ * a path index of the whole tree ("usr/share/icons" -> node)
+ * The folder doesn't own its content, see NodeArena
+ * The numbers of files, folders and bytes of the content are
+ * kept up to date, so they are known without walking the tree
  */
 
 class Folder : public AbstractFile
@@ -20,30 +26,44 @@ public:
     Folder& add(Folder* file);
     void add(RealFile* file);
     int count(bool recursive);
+    int countFiles() const;
+    int countFolders() const;
+    long long getSize() const;
     Folder *containFolder(const std::string& name, bool recursive);
     RealFile *containFile(const std::string& name);
-    void renameFolder(const std::string& oldname, const std::string& name, bool recursive);
     AbstractFile *child(int row);
     int child(AbstractFile *af);
     bool remove(AbstractFile *afile, bool recursive);
+    AbstractFile *find(const std::string& path);
+    Folder *findFolder(const std::string& path);
+    Folder *root();
+    bool isAncestorOf(AbstractFile *af);
+    std::string pathOf(AbstractFile *af);
+    void childRenamed(AbstractFile *af, const std::string& oldname);
+    void traverse(AbstractFileVisitor& visitor);
     template<class T>
-    T getChild(std::string name)
-    {
-        T ret = nullptr;
-        for (AbstractFile *af : tree){
-            if(T f = dynamic_cast<T>(af)) {
-               if (af->getName() == name){
-                   ret = f;
-                   break;
-               }
-            }
-        }
-        return ret;
-    }
+    T getChild(const std::string& name);
 
 private:
+    void indexSubtree(AbstractFile *af, const std::string& path, bool insert);
+    void unindexChild(AbstractFile *af, const std::string& name);
+    void updateCounters(AbstractFile *af, int sign);
     std::vector<AbstractFile *> tree;
+    std::unordered_map<std::string, Folder *> folders;
+    std::unordered_map<std::string, RealFile *> files;
+    // content of the subtree, this folder excluded
+    int fileCount;
+    int folderCount;
+    long long size;
+    // only filled on the root folder
+    std::unordered_map<std::string, AbstractFile *> paths;
+    std::unordered_multimap<std::string, Folder *> folderNames;
 
 };
 
+template<>
+Folder *Folder::getChild<Folder*>(const std::string& name);
+template<>
+RealFile *Folder::getChild<RealFile*>(const std::string& name);
+
 #endif // FOLDER_H
@@ -0,0 +1,80 @@
+#include "internedname.h"
+#include <unordered_map>
+#include <mutex>
+
+namespace {
+// the names in use, an entry is removed when its last InternedName is destroyed
+std::unordered_map<std::string, std::weak_ptr<const void> > &table()
+{
+    static std::unordered_map<std::string, std::weak_ptr<const void> > names;
+    return names;
+}
+
+std::mutex &tableMutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
+}
+
+InternedName::InternedName()
+    : entry(intern(std::string()))
+{
+
+}
+
+InternedName::InternedName(const std::string &str)
+    : entry(intern(str))
+{
+
+}
+
+const std::string &InternedName::str() const
+{
+    return entry->str;
+}
+
+const QString &InternedName::qstr() const
+{
+    return entry->qstr;
+}
+
+bool InternedName::operator==(const InternedName &other) const
+{
+    // same string, same entry
+    return entry == other.entry;
+}
+
+bool InternedName::operator!=(const InternedName &other) const
+{
+    return entry != other.entry;
+}
+
+std::shared_ptr<const InternedName::Entry> InternedName::intern(const std::string &str)
+{
+    std::lock_guard<std::mutex> lock(tableMutex());
+    std::shared_ptr<const Entry> ret;
+    auto it = table().find(str);
+    if (it != table().end())
+        ret = std::static_pointer_cast<const Entry>(it->second.lock());
+    if (!ret){
+        Entry *e = new Entry();
+        e->str = str;
+        e->qstr = QString::fromStdString(str);
+        ret = std::shared_ptr<const Entry>(e, &InternedName::release);
+        table()[str] = ret;
+    }
+    return ret;
+}
+
+void InternedName::release(const Entry *entry)
+{
+    {
+        std::lock_guard<std::mutex> lock(tableMutex());
+        auto it = table().find(entry->str);
+        // the name may already be interned again by another entry
+        if (it != table().end() && it->second.expired())
+            table().erase(it);
+    }
+    delete entry;
+}
@@ -0,0 +1,37 @@
+#ifndef INTERNEDNAME_H
+#define INTERNEDNAME_H
+
+#include <string>
+#include <memory>
+#include <QString>
+
+/**
+ * @brief The InternedName class
+ * A node name shared by all the nodes with the same name,
+ * the QString used by the model is converted once per name
+ */
+
+class InternedName
+{
+
+public:
+    InternedName();
+    explicit InternedName(const std::string& str);
+    const std::string& str() const;
+    const QString& qstr() const;
+    bool operator==(const InternedName& other) const;
+    bool operator!=(const InternedName& other) const;
+
+private:
+    struct Entry
+    {
+        std::string str;
+        QString qstr;
+    };
+    static std::shared_ptr<const Entry> intern(const std::string& str);
+    static void release(const Entry *entry);
+    std::shared_ptr<const Entry> entry;
+
+};
+
+#endif // INTERNEDNAME_H
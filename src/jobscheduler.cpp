@@ -0,0 +1,170 @@
+#include "jobscheduler.h"
+#include <QTimer>
+
+JobScheduler::Job::Job()
+    : timeout(0), priority(NORMAL)
+{
+
+}
+
+bool JobScheduler::Result::isSuccess() const
+{
+    return started && !timedOut && !canceled && exitStatus == QProcess::NormalExit && exitCode == 0;
+}
+
+JobScheduler::JobScheduler(int parallelism, QObject *parent)
+    : QObject(parent)
+{
+    this->parallelism = qMax(1, parallelism);
+    lastId = 0;
+}
+
+JobScheduler::~JobScheduler()
+{
+    // the results are not sent anymore, the processes are killed with their QProcess
+    for (QProcess *process : running.keys()){
+        disconnect(process, Q_NULLPTR, this, Q_NULLPTR);
+    }
+}
+
+int JobScheduler::getParallelism() const
+{
+    return parallelism;
+}
+
+void JobScheduler::setParallelism(int parallelism)
+{
+    this->parallelism = qMax(1, parallelism);
+    startJobs();
+}
+
+int JobScheduler::submit(const JobScheduler::Job &job)
+{
+    const int id = ++lastId;
+    int pos = queue.size();
+    while (pos > 0 && queue.at(pos-1).second.priority < job.priority){
+        pos--;
+    }
+    queue.insert(pos, qMakePair(id, job));
+    startJobs();
+    return id;
+}
+
+void JobScheduler::cancel(int id)
+{
+    bool found = false;
+    for (int i=0; i<queue.size() && !found; i++){
+        if (queue.at(i).first == id){
+            const Job job = queue.takeAt(i).second;
+            found = true;
+            emit jobFinished(canceledResult(id, job));
+        }
+    }
+    for (auto it = running.begin(); it != running.end() && !found; ++it){
+        if (it.value().id == id){
+            // the result is sent when the process is finished
+            it.value().canceled = true;
+            it.key()->kill();
+            found = true;
+        }
+    }
+}
+
+void JobScheduler::cancelAll()
+{
+    while (!queue.isEmpty()){
+        const QPair<int, Job> pending = queue.takeFirst();
+        emit jobFinished(canceledResult(pending.first, pending.second));
+    }
+    for (auto it = running.begin(); it != running.end(); ++it){
+        it.value().canceled = true;
+        it.key()->kill();
+    }
+}
+
+void JobScheduler::processFinished(int exitCode, QProcess::ExitStatus exitStatus)
+{
+    Q_UNUSED(exitCode);
+    Q_UNUSED(exitStatus);
+    finish(qobject_cast<QProcess*>(sender()), true);
+}
+
+void JobScheduler::processFailed(QProcess::ProcessError error)
+{
+    // finished is not emitted when the program can't be run
+    if (error == QProcess::FailedToStart)
+        finish(qobject_cast<QProcess*>(sender()), false);
+}
+
+void JobScheduler::processTimedOut()
+{
+    QProcess *process = qobject_cast<QProcess*>(sender()->parent());
+    if (running.contains(process)){
+        running[process].timedOut = true;
+        process->kill();
+    }
+}
+
+void JobScheduler::startJobs()
+{
+    while (running.size() < parallelism && !queue.isEmpty()){
+        const QPair<int, Job> pending = queue.takeFirst();
+        const Job &job = pending.second;
+        QProcess *process = new QProcess(this);
+        connect(process, SIGNAL(finished(int,QProcess::ExitStatus)), this, SLOT(processFinished(int,QProcess::ExitStatus)));
+        connect(process, SIGNAL(error(QProcess::ProcessError)), this, SLOT(processFailed(QProcess::ProcessError)));
+        Running &run = running[process];
+        run.id = pending.first;
+        run.job = job;
+        run.timedOut = false;
+        run.canceled = false;
+        run.timer.start();
+        if (job.timeout > 0){
+            QTimer *timer = new QTimer(process);
+            timer->setSingleShot(true);
+            connect(timer, SIGNAL(timeout()), this, SLOT(processTimedOut()));
+            timer->start(job.timeout);
+        }
+        if (!job.workingDirectory.isEmpty())
+            process->setWorkingDirectory(job.workingDirectory);
+        process->start(job.program, job.arguments);
+        if (!job.input.isEmpty())
+            process->write(job.input);
+        process->closeWriteChannel();
+    }
+}
+
+void JobScheduler::finish(QProcess *process, bool started)
+{
+    if (running.contains(process)){
+        const Running run = running.take(process);
+        Result result;
+        result.id = run.id;
+        result.job = run.job;
+        result.started = started;
+        result.timedOut = run.timedOut;
+        result.canceled = run.canceled;
+        result.exitCode = started ? process->exitCode() : -1;
+        result.exitStatus = started ? process->exitStatus() : QProcess::CrashExit;
+        result.output = process->readAllStandardOutput();
+        result.errors = process->readAllStandardError();
+        result.elapsed = run.timer.elapsed();
+        process->deleteLater();
+        emit jobFinished(result);
+        startJobs();
+    }
+}
+
+JobScheduler::Result JobScheduler::canceledResult(int id, const JobScheduler::Job &job) const
+{
+    Result ret;
+    ret.id = id;
+    ret.job = job;
+    ret.started = false;
+    ret.timedOut = false;
+    ret.canceled = true;
+    ret.exitCode = -1;
+    ret.exitStatus = QProcess::CrashExit;
+    ret.elapsed = 0;
+    return ret;
+}
@@ -0,0 +1,88 @@
+#ifndef JOBSCHEDULER_H
+#define JOBSCHEDULER_H
+
+#include <QObject>
+#include <QProcess>
+#include <QStringList>
+#include <QHash>
+#include <QList>
+#include <QElapsedTimer>
+
+/**
+ * @brief The JobScheduler class
+ * Run the external commands (dpkg-deb, sh -n, ...) without blocking.
+ * At most getParallelism() processes run at once, the others wait by
+ * priority then in order. A job can have a timeout and be cancelled,
+ * its result is sent by jobFinished whatever happened.
+ */
+
+class JobScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    enum Priority { LOW=0, NORMAL, HIGH };
+    struct Job
+    {
+        Job();
+        QString program;
+        QStringList arguments;
+        // written on the standard input, closed after
+        QByteArray input;
+        QString workingDirectory;
+        // in ms, 0 for none
+        int timeout;
+        Priority priority;
+    };
+    struct Result
+    {
+        int id;
+        Job job;
+        // false if the program could not be run
+        bool started;
+        bool timedOut;
+        bool canceled;
+        int exitCode;
+        QProcess::ExitStatus exitStatus;
+        QByteArray output;
+        QByteArray errors;
+        qint64 elapsed;
+        bool isSuccess() const;
+    };
+    JobScheduler(int parallelism, QObject *parent = Q_NULLPTR);
+    ~JobScheduler();
+    int getParallelism() const;
+    void setParallelism(int parallelism);
+    // returns the id given back in the result
+    int submit(const Job& job);
+    void cancel(int id);
+    void cancelAll();
+
+signals:
+    void jobFinished(const JobScheduler::Result &result);
+
+private slots:
+    void processFinished(int exitCode, QProcess::ExitStatus exitStatus);
+    void processFailed(QProcess::ProcessError error);
+    void processTimedOut();
+
+private:
+    struct Running
+    {
+        int id;
+        Job job;
+        QElapsedTimer timer;
+        bool timedOut;
+        bool canceled;
+    };
+    void startJobs();
+    void finish(QProcess *process, bool started);
+    Result canceledResult(int id, const Job& job) const;
+    int parallelism;
+    int lastId;
+    // ordered by priority, in order of submission for a priority
+    QList<QPair<int, Job> > queue;
+    QHash<QProcess*, Running> running;
+
+};
+
+#endif // JOBSCHEDULER_H
@@ -0,0 +1,462 @@
+#include "journal.h"
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QDir>
+#include <QFileInfo>
+#include <QLockFile>
+#include <QStandardPaths>
+#include <QThread>
+#include <QTimer>
+#include <cstdio>
+#include <limits>
+#include <unistd.h>
+
+namespace {
+// the edits of this delay are written and synced at once
+const int FLUSH_DELAY = 500;
+// written without waiting for the delay
+const int FLUSH_SIZE = 64*1024;
+// the journal is rewritten once its records outgrow both this size
+// and its last snapshot, the rewrite cost is shared by the edits
+const qint64 COMPACT_SIZE = 1024*1024;
+// size and checksum before each record
+const int RECORD_HEADER = 6;
+// an edit replacing the whole text, the position is clamped
+const int WHOLE_TEXT = std::numeric_limits<int>::max();
+// the journals of all the instances, the first one had no pid
+const char *const JOURNAL_PATTERN = "autosave*.journal";
+
+Journal::Entry makeEntry(Journal::Op op, const QString &path, const QString &target = QString())
+{
+    Journal::Entry ret;
+    ret.op = op;
+    ret.path = path;
+    ret.target = target;
+    ret.position = 0;
+    ret.removed = 0;
+    ret.canRename = false;
+    ret.node = 0;
+    ret.folder = 0;
+    return ret;
+}
+
+bool decode(const QByteArray &payload, Journal::Entry &entry)
+{
+    QDataStream in(payload);
+    in.setVersion(QDataStream::Qt_5_0);
+    quint8 op;
+    qint32 position, removed;
+    quint32 count;
+    in >> op >> entry.path >> entry.target >> position >> removed >> entry.canRename >> count;
+    entry.op = Journal::Op(op);
+    entry.position = position;
+    entry.removed = removed;
+    entry.files.clear();
+    for (quint32 i=0; i<count && in.status() == QDataStream::Ok; i++){
+        QString path, signature, content;
+        quint8 category;
+        qint64 size;
+        in >> path >> signature >> category >> size >> content;
+        // the signature is known, the file is not read
+        FileSignatureInfo fsi(path.toStdString(), signature.toStdString(), FileSignatureInfo::Category(category), size);
+        fsi.setContent(content.toStdString());
+        entry.files.append(fsi);
+    }
+    in >> entry.node >> entry.folder >> entry.ids;
+    return in.status() == QDataStream::Ok;
+}
+
+bool syncFile(QFile &file)
+{
+    return file.flush() && ::fsync(file.handle()) == 0;
+}
+
+/**
+ * @brief The Compactor class
+ * Write a snapshot of the project as the records that rebuild it
+ */
+
+class Compactor : public QThread
+{
+public:
+    Compactor(const Journal::Snapshot &snapshot, const QString &fileName, QObject *parent)
+        : QThread(parent), snapshot(snapshot), file(fileName)
+    {
+        done = false;
+    }
+
+    bool isDone() const
+    {
+        return done;
+    }
+
+protected:
+    void run()
+    {
+        if (file.open(QIODevice::WriteOnly | QIODevice::Truncate)){
+            Journal::Entry reset = makeEntry(Journal::RESET, snapshot.package, snapshot.version);
+            reset.node = snapshot.tree ? snapshot.tree->id : 0;
+            write(reset);
+            writeText("control", snapshot.control);
+            if (snapshot.tree)
+                writeFolder(snapshot.tree, QString());
+            for (const QPair<QString, QString> &script : snapshot.scripts){
+                write(makeEntry(Journal::ADD_SCRIPT, script.first));
+                writeText(script.first, script.second);
+            }
+            done = !isInterruptionRequested() && syncFile(file);
+            file.close();
+        }
+    }
+
+private:
+    void write(const Journal::Entry &entry)
+    {
+        file.write(Journal::encode(entry));
+    }
+
+    void writeText(const QString &tab, const QString &text)
+    {
+        Journal::Entry entry = makeEntry(Journal::EDIT_TEXT, tab, text);
+        entry.removed = WHOLE_TEXT;
+        write(entry);
+    }
+
+    void writeFolder(const PersistentTree::NodePtr &node, const QString &path)
+    {
+        // the folders before their content, the files of a folder at once
+        Journal::Entry files = makeEntry(Journal::ADD_FILES, path);
+        files.folder = node->id;
+        for (std::size_t i=0; i<node->children.size() && !isInterruptionRequested(); i++){
+            const PersistentTree::NodePtr &c = node->children.at(i);
+            if (c->folder){
+                const QString childPath = path.isEmpty() ? c->name.qstr() : path+"/"+c->name.qstr();
+                Journal::Entry folder = makeEntry(Journal::ADD_FOLDER, childPath);
+                folder.canRename = c->canRename;
+                folder.node = c->id;
+                folder.folder = node->id;
+                write(folder);
+                writeFolder(c, childPath);
+            } else if (c->info){
+                files.files.append(*c->info);
+                files.ids.append(c->id);
+            }
+        }
+        if (!files.files.isEmpty())
+            write(files);
+    }
+
+    Journal::Snapshot snapshot;
+    QFile file;
+    bool done;
+};
+}
+
+Journal::Journal(const QString &fileName, QObject *parent)
+    : QObject(parent), fileName(fileName)
+{
+    compactor = Q_NULLPTR;
+    orphanLock = Q_NULLPTR;
+    // only a dead process leaves a stale lock, however old a live one is
+    QDir().mkpath(QFileInfo(fileName).absolutePath());
+    lock = new QLockFile(fileName+".lock");
+    lock->setStaleLockTime(0);
+    lock->tryLock(0);
+    hasQueued = false;
+    suspended = false;
+    written = 0;
+    compactedSize = 0;
+    timer = new QTimer(this);
+    timer->setSingleShot(true);
+    timer->setInterval(FLUSH_DELAY);
+    connect(timer, SIGNAL(timeout()), this, SLOT(flush()));
+}
+
+Journal::~Journal()
+{
+    if (compactor){
+        compactor->requestInterruption();
+        compactor->wait();
+        delete compactor;
+    }
+    flush();
+    delete timer;
+    dropOrphan();
+    delete lock;
+}
+
+bool Journal::read(const QString &fileName, QVector<Journal::Entry> &entries)
+{
+    bool ret = false;
+    QFile file(fileName);
+    if (file.open(QIODevice::ReadOnly)){
+        const QByteArray data = file.readAll();
+        file.close();
+        // a record cut by a crash ends the replay
+        int pos = 0;
+        bool valid = true;
+        while (valid && data.size()-pos >= RECORD_HEADER){
+            QDataStream header(data.mid(pos, RECORD_HEADER));
+            quint32 size;
+            quint16 checksum;
+            header >> size >> checksum;
+            valid = size <= quint32(data.size()-pos-RECORD_HEADER);
+            if (valid){
+                const QByteArray payload = data.mid(pos+RECORD_HEADER, size);
+                Entry entry;
+                valid = qChecksum(payload.constData(), payload.size()) == checksum && decode(payload, entry);
+                if (valid)
+                    entries.append(entry);
+                pos += RECORD_HEADER+size;
+            }
+        }
+        ret = true;
+    }
+    return ret;
+}
+
+QString Journal::defaultFileName()
+{
+    // one per instance, the instances running together don't share it
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)
+            +QString("/autosave-%1.journal").arg(QCoreApplication::applicationPid());
+}
+
+QByteArray Journal::encode(const Journal::Entry &entry)
+{
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << quint8(entry.op) << entry.path << entry.target << qint32(entry.position) << qint32(entry.removed) << entry.canRename;
+    out << quint32(entry.files.size());
+    for (FileSignatureInfo fsi : entry.files){
+        out << QString(fsi.getPath().c_str()) << QString(fsi.getHex_signature().c_str()) << quint8(fsi.getCategory()) << qint64(fsi.getSize());
+        out << QString(fsi.getContent().c_str());
+    }
+    out << entry.node << entry.folder << entry.ids;
+    QByteArray ret;
+    QDataStream header(&ret, QIODevice::WriteOnly);
+    header << quint32(payload.size()) << quint16(qChecksum(payload.constData(), payload.size()));
+    ret.append(payload);
+    return ret;
+}
+
+const QString &Journal::getFileName() const
+{
+    return fileName;
+}
+
+void Journal::setSuspended(bool suspended)
+{
+    this->suspended = suspended;
+}
+
+bool Journal::isSuspended() const
+{
+    return suspended;
+}
+
+void Journal::compact(const Journal::Snapshot &snapshot)
+{
+    if (!suspended){
+        if (compactor){
+            // only the last state matters
+            queued = snapshot;
+            hasQueued = true;
+        } else {
+            flush();
+            tail.clear();
+            written = 0;
+            compactor = new Compactor(snapshot, fileName+".tmp", this);
+            connect(compactor, SIGNAL(finished()), this, SLOT(compacted()));
+            compactor->start();
+        }
+    }
+}
+
+void Journal::discard()
+{
+    timer->stop();
+    if (compactor){
+        compactor->requestInterruption();
+        compactor->wait();
+        delete compactor;
+        compactor = Q_NULLPTR;
+    }
+    hasQueued = false;
+    pending.clear();
+    tail.clear();
+    written = 0;
+    file.close();
+    QFile::remove(fileName);
+    QFile::remove(fileName+".tmp");
+}
+
+QString Journal::takeOrphan()
+{
+    // the most recent first, the journals of the running instances are locked
+    dropOrphan();
+    const QFileInfo own(fileName);
+    const QFileInfoList journals = own.absoluteDir().entryInfoList(QStringList() << JOURNAL_PATTERN, QDir::Files, QDir::Time);
+    for (int i=0; i<journals.size() && orphan.isEmpty(); i++){
+        const QString name = journals.at(i).absoluteFilePath();
+        if (name != own.absoluteFilePath()){
+            QLockFile *other = new QLockFile(name+".lock");
+            other->setStaleLockTime(0);
+            if (other->tryLock(0)){
+                orphanLock = other;
+                orphan = name;
+            } else {
+                delete other;
+            }
+        }
+    }
+    return orphan;
+}
+
+void Journal::dropOrphan()
+{
+    if (orphanLock){
+        QFile::remove(orphan);
+        QFile::remove(orphan+".tmp");
+        // the lock file is removed with it
+        delete orphanLock;
+        orphanLock = Q_NULLPTR;
+        orphan.clear();
+    }
+}
+
+void Journal::addFolder(quint64 id, quint64 parent, const QString &path, bool canRename)
+{
+    Entry entry = makeEntry(ADD_FOLDER, path);
+    entry.canRename = canRename;
+    entry.node = id;
+    entry.folder = parent;
+    append(entry);
+}
+
+void Journal::addFiles(quint64 folder, const QVector<quint64> &ids, const QVector<FileSignatureInfo *> &infos)
+{
+    Entry entry = makeEntry(ADD_FILES, QString());
+    entry.folder = folder;
+    entry.ids = ids;
+    entry.files.reserve(infos.size());
+    for (FileSignatureInfo *fsi : infos){
+        entry.files.append(*fsi);
+    }
+    append(entry);
+}
+
+void Journal::removeNode(quint64 id)
+{
+    Entry entry = makeEntry(REMOVE, QString());
+    entry.node = id;
+    append(entry);
+}
+
+void Journal::moveNode(quint64 id, quint64 folder)
+{
+    Entry entry = makeEntry(MOVE, QString());
+    entry.node = id;
+    entry.folder = folder;
+    append(entry);
+}
+
+void Journal::renameNode(quint64 id, const QString &name)
+{
+    Entry entry = makeEntry(RENAME, QString(), name);
+    entry.node = id;
+    append(entry);
+}
+
+void Journal::addScript(const QString &name)
+{
+    append(makeEntry(ADD_SCRIPT, name));
+}
+
+void Journal::removeScript(const QString &name)
+{
+    append(makeEntry(REMOVE_SCRIPT, name));
+}
+
+void Journal::editText(const QString &tab, int position, int removed, const QString &text)
+{
+    Entry entry = makeEntry(EDIT_TEXT, tab, text);
+    entry.position = position;
+    entry.removed = removed;
+    append(entry);
+}
+
+void Journal::flush()
+{
+    timer->stop();
+    if (!pending.isEmpty() && openFile()){
+        file.write(pending);
+        syncFile(file);
+        pending.clear();
+    }
+}
+
+void Journal::compacted()
+{
+    Compactor *done = static_cast<Compactor*>(compactor);
+    done->wait();
+    QFile result(fileName+".tmp");
+    if (done->isDone() && result.open(QIODevice::WriteOnly | QIODevice::Append)){
+        // the edits made during the compaction follow the snapshot
+        result.write(tail);
+        if (syncFile(result)){
+            compactedSize = result.size();
+            result.close();
+            // the old journal is valid until replaced at once
+            if (std::rename(QFile::encodeName(result.fileName()).constData(), QFile::encodeName(fileName).constData()) == 0){
+                // the edits not written yet are already in the tail
+                timer->stop();
+                pending.clear();
+                file.close();
+            } else {
+                result.remove();
+            }
+        } else {
+            result.close();
+            result.remove();
+        }
+    } else {
+        result.remove();
+    }
+    tail.clear();
+    done->deleteLater();
+    compactor = Q_NULLPTR;
+    if (hasQueued){
+        hasQueued = false;
+        compact(queued);
+        queued = Snapshot();
+    }
+}
+
+void Journal::append(const Journal::Entry &entry)
+{
+    if (!suspended){
+        const QByteArray record = encode(entry);
+        pending.append(record);
+        if (compactor)
+            tail.append(record);
+        written += record.size();
+        if (pending.size() >= FLUSH_SIZE)
+            flush();
+        else if (!timer->isActive())
+            timer->start();
+        if (!compactor && written > qMax(COMPACT_SIZE, compactedSize))
+            emit compactionNeeded();
+    }
+}
+
+bool Journal::openFile()
+{
+    if (!file.isOpen()){
+        QDir().mkpath(QFileInfo(fileName).absolutePath());
+        file.setFileName(fileName);
+        file.open(QIODevice::WriteOnly | QIODevice::Append);
+    }
+    return file.isOpen();
+}
@@ -0,0 +1,109 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "filesignatureinfo.hpp"
+#include "persistenttree.h"
+#include <QObject>
+#include <QFile>
+#include <QPair>
+#include <QVector>
+
+class QTimer;
+class QThread;
+class QLockFile;
+
+/**
+ * @brief The Journal class
+ * Append-only autosave of the project: every edit of the tree or of
+ * the editors is one record, written in batches and synced, so its
+ * cost follows the size of the edit and not the size of the project.
+ * The journal is rewritten in background from a snapshot when it grows,
+ * and replayed after a crash to recover the session.
+ * Each instance has its own journal, locked while it runs.
+ */
+
+class Journal : public QObject
+{
+    Q_OBJECT
+public:
+    enum Op { RESET=1, ADD_FOLDER, ADD_FILES, REMOVE, MOVE, RENAME, ADD_SCRIPT, REMOVE_SCRIPT, EDIT_TEXT };
+    struct Entry
+    {
+        Op op;
+        // path of the added folder, or tab, the package name for RESET
+        QString path;
+        // new name or inserted text, the version for RESET
+        QString target;
+        int position;
+        int removed;
+        bool canRename;
+        QVector<FileSignatureInfo> files;
+        // the nodes are given by id, sibling folders can have the same path:
+        // the node edited or added (the root for RESET), its folder and
+        // the ids of the added files
+        quint64 node;
+        quint64 folder;
+        QVector<quint64> ids;
+    };
+    struct Snapshot
+    {
+        PersistentTree::NodePtr tree;
+        QString package;
+        QString version;
+        QString control;
+        QVector<QPair<QString, QString> > scripts;
+    };
+    Journal(const QString& fileName, QObject *parent = Q_NULLPTR);
+    ~Journal();
+    static bool read(const QString& fileName, QVector<Entry>& entries);
+    static QString defaultFileName();
+    static QByteArray encode(const Entry& entry);
+    const QString& getFileName() const;
+    void setSuspended(bool suspended);
+    bool isSuspended() const;
+    void compact(const Snapshot& snapshot);
+    void discard();
+    // the journal left by an instance no longer running, locked until dropped
+    QString takeOrphan();
+    void dropOrphan();
+
+public slots:
+    void addFolder(quint64 id, quint64 parent, const QString& path, bool canRename);
+    void addFiles(quint64 folder, const QVector<quint64>& ids, const QVector<FileSignatureInfo *>& infos);
+    void removeNode(quint64 id);
+    void moveNode(quint64 id, quint64 folder);
+    void renameNode(quint64 id, const QString& name);
+    void addScript(const QString& name);
+    void removeScript(const QString& name);
+    void editText(const QString& tab, int position, int removed, const QString& text);
+    void flush();
+
+signals:
+    void compactionNeeded();
+
+private slots:
+    void compacted();
+
+private:
+    void append(const Entry& entry);
+    bool openFile();
+    QString fileName;
+    QFile file;
+    QLockFile *lock;
+    QLockFile *orphanLock;
+    QString orphan;
+    // records not written yet, see flush()
+    QByteArray pending;
+    // records appended while a compaction runs, added to its result
+    QByteArray tail;
+    QTimer *timer;
+    QThread *compactor;
+    Snapshot queued;
+    bool hasQueued;
+    bool suspended;
+    qint64 written;
+    qint64 compactedSize;
+
+};
+
+#endif // JOURNAL_H
@@ -8,19 +8,61 @@
 #include "treepackagedragdropmodel.h"
 #include "scripteditortabwidget.h"
 #include "controlfileeditor.h"
+#include "controlparser.h"
 #include "menufile.h"
 #include "menuhelp.h"
-#include "processdpkgdeb.h"
+#include "nodearena.h"
+#include "projectfile.h"
+#include "projectrestorer.h"
+#include "journal.h"
+#include "blobstore.h"
 #include <QListView>
+#include <QListWidget>
 #include <QGridLayout>
 #include <QSplitter>
 #include <QJsonObject>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QFileDialog>
-#include <QProcess>
+#include <QTemporaryDir>
+#include <QThread>
 #include <QToolButton>
 #include <QMessageBox>
+#include <QLineEdit>
+#include <QVBoxLayout>
+#include <QApplication>
+#include <QTimer>
+
+namespace {
+/**
+ * @brief The StoreTask class
+ * Copy the files missing from the BlobStore of a project in background,
+ * the project is written once they are stored
+ */
+
+class StoreTask : public QThread
+{
+public:
+    StoreTask(const QString &dir, const QVector<RealFile*> &files, const QStringList &sources, const QString &project, QObject *parent)
+        : QThread(parent), store(dir), files(files), sources(sources), project(project)
+    {
+
+    }
+
+    const BlobStore store;
+    const QVector<RealFile*> files;
+    const QStringList sources;
+    const QString project;
+    // empty for the files that can't be stored
+    QVector<QString> hashes;
+
+protected:
+    void run()
+    {
+        hashes = store.ingest(sources);
+    }
+};
+}
 
 const QString MainWindow::version = "1";
 
@@ -28,6 +70,8 @@ MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
     ui(new Ui::MainWindow)
 {
+    restorer = Q_NULLPTR;
+    storing = Q_NULLPTR;
     ui->setupUi(this);
     setWindowTitle("Debian package helper");
     setWindowIcon(QIcon("://icon/package.png"));
@@ -43,7 +87,7 @@ MainWindow::MainWindow(QWidget *parent) :
     toolScript->setPopupMode(QToolButton::InstantPopup);
     ui->mainToolBar->addWidget(toolScript);
     for (QAction *a : menuFile->actions()){
-        if (!toolScript->actions().contains(a))
+        if (!toolScript->actions().contains(a) && !a->isCheckable())
             ui->mainToolBar->addAction(a);
     }
     menuFile->addSeparator();
@@ -54,10 +98,28 @@ MainWindow::MainWindow(QWidget *parent) :
 
     splitter = new QSplitter(Qt::Horizontal, this);
     tabWidget = new ScripEditorTabWidget(this);
-    treeView = new TreeView(this);
+    treePanel = new QWidget(this);
+    treeLayout = new QVBoxLayout(treePanel);
+    treeLayout->setContentsMargins(0, 0, 0, 0);
+    searchEdit = new QLineEdit(treePanel);
+    searchEdit->setPlaceholderText(tr("Search in the package"));
+    searchEdit->setClearButtonEnabled(true);
+    treeView = new TreeView(treePanel);
+    treeLayout->addWidget(searchEdit);
+    treeLayout->addWidget(treeView);
+
+    // the issues of the package under the editors, shown when checked
+    editorSplitter = new QSplitter(Qt::Vertical, this);
+    lintList = new QListWidget(editorSplitter);
+    lintList->hide();
+    lint = 0;
+    qRegisterMetaType<QVector<LintIssue> >("QVector<LintIssue>");
+    editorSplitter->addWidget(tabWidget);
+    editorSplitter->addWidget(lintList);
+    editorSplitter->setStretchFactor(0, 3);
 
-    splitter->addWidget(treeView);
-    splitter->addWidget(tabWidget);
+    splitter->addWidget(treePanel);
+    splitter->addWidget(editorSplitter);
     gLayout->addWidget(splitter, 0, 0);
 
     splitter->setStretchFactor(1, 2);
@@ -70,17 +132,55 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(menuFile, SIGNAL(wantDesktop(QString)), treeView->model(), SLOT(addDesktopFile(QString)));
     connect(treeView->model(), SIGNAL(changeDesktopTab(QString, QString)), tabWidget, SLOT(renameDesktopTab(QString,QString)));
     connect(tabWidget, SIGNAL(removeScriptTab(QString)), treeView->model(), SLOT(removeScriptFile(QString)));
+    connect(searchEdit, SIGNAL(textChanged(QString)), treeView, SLOT(search(QString)));
+    connect(searchEdit, SIGNAL(returnPressed()), treeView, SLOT(nextMatch()));
 
     connect(menuFile, SIGNAL(wantGeneratePackage()), this, SLOT(generatePackage()));
-    connect(menuFile, SIGNAL(savePackageProject()), this, SLOT(saveToJson()));
-    connect(menuFile, SIGNAL(importPackageProject()), this, SLOT(restoreFromJson()));
+    connect(menuFile, SIGNAL(wantCheckPackage()), this, SLOT(checkPackage()));
+    connect(menuFile, SIGNAL(savePackageProject()), this, SLOT(saveProject()));
+    connect(menuFile, SIGNAL(importPackageProject()), this, SLOT(restoreProject()));
     connect(actionQuit, SIGNAL(triggered(bool)), this, SLOT(close()));
+
+    // every edit is journaled, the journal is replayed after a crash
+    journal = new Journal(Journal::defaultFileName(), this);
+    connect(treeView->model(), SIGNAL(folderAdded(quint64,quint64,QString,bool)), journal, SLOT(addFolder(quint64,quint64,QString,bool)));
+    connect(treeView->model(), SIGNAL(filesAdded(quint64,QVector<quint64>,QVector<FileSignatureInfo*>)), journal, SLOT(addFiles(quint64,QVector<quint64>,QVector<FileSignatureInfo*>)));
+    connect(treeView->model(), SIGNAL(nodeRemoved(quint64)), journal, SLOT(removeNode(quint64)));
+    connect(treeView->model(), SIGNAL(nodeMoved(quint64,quint64)), journal, SLOT(moveNode(quint64,quint64)));
+    connect(treeView->model(), SIGNAL(nodeRenamed(quint64,QString)), journal, SLOT(renameNode(quint64,QString)));
+    connect(treeView->model(), SIGNAL(treeReplaced()), this, SLOT(compactJournal()));
+    connect(menuFile, SIGNAL(wantScript(QString)), journal, SLOT(addScript(QString)));
+    connect(menuFile, SIGNAL(wantDesktop(QString)), journal, SLOT(addScript(QString)));
+    connect(tabWidget, SIGNAL(removeScriptTab(QString)), journal, SLOT(removeScript(QString)));
+    connect(tabWidget, SIGNAL(textEdited(QString,int,int,QString)), journal, SLOT(editText(QString,int,int,QString)));
+    connect(journal, SIGNAL(compactionNeeded()), this, SLOT(compactJournal()));
+    QTimer::singleShot(0, this, SLOT(recoverSession()));
+
+    // the external commands don't block the window
+    jobs = new JobScheduler(QThread::idealThreadCount(), this);
+    connect(jobs, SIGNAL(jobFinished(JobScheduler::Result)), this, SLOT(jobFinished(JobScheduler::Result)));
 }
 
 MainWindow::~MainWindow()
 {
+    // the store being written is not used
+    if (storing)
+        storing->wait();
+    delete storing;
+    // closed properly, nothing to recover
+    journal->discard();
+    delete journal;
+    delete jobs;
+    qDeleteAll(builds);
+    delete restorer;
     delete treeView;
+    delete searchEdit;
+    delete treeLayout;
+    delete treePanel;
+    qDeleteAll(findChildren<PackageLinter*>());
     delete tabWidget;
+    delete lintList;
+    delete editorSplitter;
     delete splitter;
     delete gLayout;
     delete toolScript;
@@ -90,180 +190,560 @@ MainWindow::~MainWindow()
     delete ui;
 }
 
-void MainWindow::saveToJson()
+void MainWindow::saveProject()
 {
     QString fileName = QFileDialog::getSaveFileName(this,
                                                     tr("Save state"),
-                                                    tabWidget->getControlFile()->getPackageName()+"-"+tabWidget->getControlFile()->getVersion()+".json",
-                                                    tr("Json file (*.json)"));
+                                                    tabWidget->getControlFile()->getPackageName()+"-"+tabWidget->getControlFile()->getVersion()+".debpac",
+                                                    tr("Project file (*.debpac);;Json file (*.json)"));
     if (!fileName.isNull()){
-        QJsonObject mainInfo;
-        mainInfo.insert("package", QJsonValue::fromVariant(tabWidget->getControlFile()->getPackageName()));
-        mainInfo.insert("version", QJsonValue::fromVariant(tabWidget->getControlFile()->getVersion()));
-        mainInfo.insert("control", QJsonValue::fromVariant(tabWidget->getControlFile()->toPlainText()));
-
-        QJsonObject scriptObject;
-        for (CodeEditor *ce : tabWidget->getScriptTabs()){
-            int idx = tabWidget->indexOf(ce);
-            if (idx != -1){
-                scriptObject.insert(tabWidget->tabText(idx), QJsonValue::fromVariant(ce->toPlainText()));
-            }
+        bool saved = true;
+        if (fileName.endsWith(".json", Qt::CaseInsensitive))
+            saved = saveToJson(fileName);
+        else if (menuFile->isStoreEnabled())
+            // written once the files are stored, see filesStored()
+            storeFiles(BlobStore::forProject(fileName, tabWidget->getControlFile()->getPackageName()), fileName);
+        else
+            saved = saveToBinary(fileName);
+        if (!saved)
+            QMessageBox::warning(this, tr("Save state"), QString("Can't write %1").arg(fileName));
+    }
+}
+
+void MainWindow::restoreProject()
+{
+    QString fileName = QFileDialog::getOpenFileName(this, tr("Load file"), QString(), tr("Projects (*.debpac *.json);;All files (*.*)"));
+    if (!fileName.isNull()){
+        if (ProjectFile::isProjectFile(fileName))
+            restoreFromBinary(fileName);
+        else
+            restoreFromJson(fileName);
+    }
+}
+
+QVector<QPair<QString, QString> > MainWindow::getScripts()
+{
+    QVector<QPair<QString, QString> > ret;
+    for (CodeEditor *ce : tabWidget->getScriptTabs()){
+        int idx = tabWidget->indexOf(ce);
+        if (idx != -1){
+            ret.append(qMakePair(tabWidget->tabText(idx), ce->toPlainText()));
         }
-        mainInfo.insert("script", scriptObject);
+    }
+    return ret;
+}
+
+bool MainWindow::saveToJson(const QString &fileName)
+{
+    bool ret = false;
+    QJsonObject mainInfo;
+    mainInfo.insert("package", QJsonValue::fromVariant(tabWidget->getControlFile()->getPackageName()));
+    mainInfo.insert("version", QJsonValue::fromVariant(tabWidget->getControlFile()->getVersion()));
+    mainInfo.insert("control", QJsonValue::fromVariant(tabWidget->getControlFile()->toPlainText()));
+
+    QJsonObject scriptObject;
+    for (const QPair<QString, QString> &script : getScripts()){
+        scriptObject.insert(script.first, QJsonValue::fromVariant(script.second));
+    }
+    mainInfo.insert("script", scriptObject);
+
+    // one entry per file, several files can be in the same folder
+    QJsonArray filesArray;
+    auto treeModel = dynamic_cast<TreePackageDragDropModel*>(treeView->model());
+    for (RealFile *rf : treeModel->getFileFromUser()){
+        const QString source = rf->getFileSignatureInfo().getPath().c_str();
+        QJsonObject fileObject;
+        fileObject.insert("folder", rf->getParent()->getInstallPath());
+        fileObject.insert("source", source);
+        fileObject.insert("mode", int(rf->getMode() ? rf->getMode() : quint32(QFile::permissions(source))));
+        filesArray.append(fileObject);
+    }
+    mainInfo.insert("files", filesArray);
 
-        QJsonObject treeObject;
+    QJsonDocument jsonDoc(mainInfo);
+    QFile file(fileName);
+    if (file.open(QIODevice::WriteOnly)){
+        ret = file.write(jsonDoc.toJson()) != -1;
+        file.close();
+    }
+    return ret;
+}
+
+bool MainWindow::saveToBinary(const QString &fileName)
+{
+    auto treeModel = dynamic_cast<TreePackageDragDropModel*>(treeView->model());
+    return ProjectFile::write(fileName,
+                              tabWidget->getControlFile()->getPackageName(),
+                              tabWidget->getControlFile()->getVersion(),
+                              tabWidget->getControlFile()->toPlainText(),
+                              getScripts(),
+                              treeModel->getFileFromUser());
+}
+
+void MainWindow::storeFiles(const QString &dir, const QString &project)
+{
+    // only the files missing from this store are read, in parallel
+    auto treeModel = dynamic_cast<TreePackageDragDropModel*>(treeView->model());
+    BlobStore store(dir);
+    BlobStore previous(storeDir);
+    QVector<RealFile*> files;
+    QStringList sources;
+    for (RealFile *rf : treeModel->getFileFromUser()){
+        FileSignatureInfo &fsi = rf->getFileSignatureInfo();
+        const QString content = fsi.getContent().c_str();
+        if (!store.contains(content)){
+            const QString source = fsi.getPath().c_str();
+            files.append(rf);
+            // a moved source can still be in the store of another project
+            if (!QFileInfo::exists(source) && !storeDir.isEmpty() && previous.contains(content))
+                sources.append(previous.pathOf(content));
+            else
+                sources.append(source);
+        }
+    }
+    // the files must stay in the tree while they are read
+    ui->centralWidget->setEnabled(false);
+    setProjectActionsEnabled(false);
+    storing = new StoreTask(dir, files, sources, project, this);
+    connect(storing, SIGNAL(finished()), this, SLOT(filesStored()));
+    storing->start();
+}
+
+void MainWindow::filesStored()
+{
+    if (storing){
+        // finished() is sent just before the thread ends
+        storing->wait();
+        StoreTask *task = static_cast<StoreTask*>(storing);
+        int failed = 0;
+        for (int i=0; i<task->files.size(); i++){
+            if (task->hashes.at(i).isEmpty())
+                failed++;
+            else
+                task->files.at(i)->getFileSignatureInfo().setContent(task->hashes.at(i).toStdString());
+        }
+        storeDir = task->store.getDir();
+        const QString project = task->project;
+        storing->deleteLater();
+        storing = Q_NULLPTR;
+        ui->centralWidget->setEnabled(true);
+        setProjectActionsEnabled(true);
+        if (failed > 0)
+            QMessageBox::warning(this, tr("Save state"), QString("%1 files can't be stored in %2").arg(failed).arg(storeDir));
+        if (!saveToBinary(project))
+            QMessageBox::warning(this, tr("Save state"), QString("Can't write %1").arg(project));
+    }
+}
+
+void MainWindow::restoreState(const QString &package, const QString &version, const QString &control, const QVector<QPair<QString, QString> > &scripts,
+                              const QVector<RestoreEntry> &entries)
+{
+    // the journal restarts from the restored project, the restored
+    // texts are not journaled as edits
+    journal->setSuspended(true);
+    // the file and content will be ok... reset before import,
+    // the tree is replaced once the restorer has built the new one
+    tabWidget->resetToDefault();
+
+    tabWidget->getControlFile()->setPackageName(package);
+    tabWidget->getControlFile()->setVersion(version);
+    tabWidget->getControlFile()->setPlainText(control);
+
+    restoredScripts.clear();
+    for (const QPair<QString, QString> &script : scripts){
+        int tab_idx = -1;
+        if (script.first.contains(".desktop")){
+            tab_idx = tabWidget->addDesktopEdit();
+        } else {
+            tab_idx = tabWidget->addScriptEdit(script.first);
+        }
+        restoredScripts.append(script.first);
+        if (tab_idx)
+            dynamic_cast<CodeEditor*>(tabWidget->widget(tab_idx))->setPlainText(script.second);
+    }
+
+    delete restorer;
+    restorer = new ProjectRestorer(entries, package, this);
+    connect(restorer, SIGNAL(finished()), this, SLOT(projectRestored()));
+    ui->centralWidget->setEnabled(false);
+    setProjectActionsEnabled(false);
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    restorer->start();
+}
+
+void MainWindow::projectRestored()
+{
+    if (restorer){
+        // finished() is sent just before the thread ends
+        restorer->wait();
         auto treeModel = dynamic_cast<TreePackageDragDropModel*>(treeView->model());
-        for (RealFile *rf : treeModel->getFileFromUser()){
-            QString treePath;
-            AbstractFile *parent = rf->getParent();
-            while (parent->getParent() != nullptr){
-                treePath.prepend(QString(parent->getName().c_str())+"/");
-                parent = parent->getParent();
-            }
-            treePath.chop(1); // remove last '/'
-            treeObject.insert(treePath, QJsonValue::fromVariant(rf->getFileSignatureInfo().getPath().c_str()));
+        treeModel->adoptTree(restorer->takeArena(), restorer->getRoot(), restorer->getFiles(), restorer->getPackageFolders());
+        for (const QString &name : restoredScripts){
+            if (name.contains(".desktop"))
+                treeModel->addDesktopFile(name);
+            else
+                treeModel->addScriptFile(name);
+        }
+        journal->setSuspended(false);
+        compactJournal();
+        const QStringList missing = restorer->getMissing();
+        restorer->deleteLater();
+        restorer = Q_NULLPTR;
+        treeView->expandDefault();
+        QApplication::restoreOverrideCursor();
+        ui->centralWidget->setEnabled(true);
+        setProjectActionsEnabled(true);
+        if (!missing.isEmpty()){
+            // one summary for all the files, the list is cut if too long
+            const int shown = 20;
+            QString text = QString("%1 files of the project were not found:\n").arg(missing.size());
+            text += QStringList(missing.mid(0, shown)).join("\n");
+            if (missing.size() > shown)
+                text += QString("\n... and %1 more").arg(missing.size()-shown);
+            QMessageBox::warning(this, tr("Load file"), text);
         }
-        mainInfo.insert("tree", treeObject);
+    }
+}
+
+void MainWindow::setProjectActionsEnabled(bool enabled)
+{
+    // while restoring, the editors are ahead of the tree: saving or
+    // generating would mix the new control and scripts with the old files
+    for (QAction *action : menuFile->actions()){
+        if (action != actionQuit)
+            action->setEnabled(enabled);
+    }
+    toolScript->setEnabled(enabled);
+}
 
-        QJsonDocument jsonDoc(mainInfo);
-        QFile file(fileName);
-        if (file.open(QIODevice::WriteOnly)){
-            file.write(jsonDoc.toJson());
-            file.close();
+void MainWindow::recoverSession()
+{
+    QVector<Journal::Entry> entries;
+    // the journals are removed on exit, one only remains after a crash
+    const QString orphan = journal->takeOrphan();
+    if (!orphan.isEmpty() && Journal::read(orphan, entries) && !entries.isEmpty()){
+        if (QMessageBox::question(this, tr("Recover session"), tr("The last session was not closed properly, recover its unsaved work?")) == QMessageBox::Yes)
+            replayJournal(entries);
+    }
+    // recovered or not, it is not offered again
+    journal->dropOrphan();
+    compactJournal();
+}
+
+void MainWindow::compactJournal()
+{
+    // the tree snapshot is shared, it is written in background
+    auto treeModel = dynamic_cast<TreePackageDragDropModel*>(treeView->model());
+    Journal::Snapshot snapshot;
+    snapshot.tree = treeModel->snapshot();
+    snapshot.package = tabWidget->getControlFile()->getPackageName();
+    snapshot.version = tabWidget->getControlFile()->getVersion();
+    snapshot.control = tabWidget->getControlFile()->toPlainText();
+    snapshot.scripts = getScripts();
+    journal->compact(snapshot);
+}
+
+void MainWindow::checkPackage()
+{
+    // the issues of a previous check are not shown anymore
+    for (PackageLinter *linter : findChildren<PackageLinter*>()){
+        linter->requestInterruption();
+    }
+    lint++;
+    lintList->clear();
+    lintList->show();
+    tabWidget->getControlFile()->notifyChanges();
+    QHash<QString, QString> texts;
+    for (const QPair<QString, QString> &script : getScripts()){
+        texts.insert(script.first, script.second);
+    }
+    auto treeModel = dynamic_cast<TreePackageDragDropModel*>(treeView->model());
+    const QString architecture = tabWidget->getControlFile()->getParser().value(QString("Architecture")).trimmed().toString();
+    PackageLinter *linter = new PackageLinter(lint, treeModel->liveSnapshot(storeDir), architecture, texts, this);
+    connect(linter, SIGNAL(issuesFound(int,QVector<LintIssue>)), this, SLOT(addLintIssues(int,QVector<LintIssue>)));
+    connect(linter, SIGNAL(finished()), this, SLOT(lintFinished()));
+    connect(linter, SIGNAL(finished()), linter, SLOT(deleteLater()));
+    linter->start();
+}
+
+void MainWindow::addLintIssues(int lint, const QVector<LintIssue> &issues)
+{
+    if (lint == this->lint){
+        for (const LintIssue &issue : issues){
+            QListWidgetItem *item = new QListWidgetItem(QString("%1: %2").arg(issue.path, issue.message), lintList);
+            item->setForeground(issue.severity == LintIssue::ERROR ? Qt::darkRed : Qt::darkYellow);
         }
     }
 }
 
-void MainWindow::restoreFromJson()
+void MainWindow::lintFinished()
 {
-    QString fileName = QFileDialog::getOpenFileName(this, tr("Load file"), QString(), tr("Json files (*.json);;All files (*.*)"));
-    if (!fileName.isNull()){
-        QFile file(fileName);
-        if (file.open(QIODevice::ReadOnly)){
-            QJsonDocument json_doc(QJsonDocument::fromJson(file.readAll()));
-            file.close();
-            if (!json_doc.isNull()){
-                QJsonObject json_obj = json_doc.object();
-                if (!json_obj.isEmpty()){
-                    // the file and content will be ok... reset before import
-                    auto treeModel = dynamic_cast<TreePackageDragDropModel*>(treeView->model());
-                    treeModel->resetToDefault();
-                    tabWidget->resetToDefault();
-
-                    const QString package = json_obj.take("package").toString();
-                    const QString version = json_obj.take("version").toString();
-                    const QString control = json_obj.take("control").toString();
-                    tabWidget->getControlFile()->setPackageName(package);
-                    tabWidget->getControlFile()->setVersion(version);
-                    tabWidget->getControlFile()->setPlainText(control);
-
-                    QJsonObject scripts = json_obj.take("script").toObject();
-                    for (QString key : scripts.keys()){
-                        int tab_idx = -1;
-                        if (key.contains(".desktop")){
-                            tab_idx = tabWidget->addDesktopEdit();
-                            treeModel->addDesktopFile(key);
-                        } else {
-                            tab_idx = tabWidget->addScriptEdit(key);
-                            treeModel->addScriptFile(key);
-                        }
-                        if (tab_idx)
-                            dynamic_cast<CodeEditor*>(tabWidget->widget(tab_idx))->setPlainText(scripts.take(key).toString());
-                    }
+    PackageLinter *linter = qobject_cast<PackageLinter*>(sender());
+    if (linter && linter->getLint() == lint && lintList->count() == 0)
+        new QListWidgetItem(tr("No problem found in the package"), lintList);
+}
 
-                    QJsonObject tree = json_obj.take("tree").toObject();
-                    for (QString key : tree.keys()){
-                        const QString file_info = tree.take(key).toString();
-                        FileSignatureInfo *fsi = new FileSignatureInfo(file_info.toStdString());
-                        if (fsi->getCategory() == FileSignatureInfo::INEXISTANT){
-                            delete fsi;
-                        } else {
-                            treeModel->addFileInfo(key, fsi);
-                        }
+void MainWindow::jobFinished(const JobScheduler::Result &result)
+{
+    if (builds.contains(result.id)){
+        delete builds.take(result.id);
+        const QString deb_name = result.job.arguments.last();
+        if (result.isSuccess()){
+            QMessageBox::information(this, tr("Generate status"), QString("You package is located to:\n%1").arg(deb_name));
+        } else if (!result.started){
+            QMessageBox::critical(this, tr("Generate status"), QString("Error with the command line:\n%1").arg(result.job.program));
+        } else if (!result.canceled){
+            QMessageBox::critical(this, tr("Generate status"), QString("dpkg-deb finish with code %1\n%2")
+                                  .arg(result.exitCode).arg(QString::fromLocal8Bit(result.errors).trimmed()));
+        }
+    }
+}
+
+void MainWindow::replayJournal(const QVector<Journal::Entry> &entries)
+{
+    // the replayed edits are not journaled again
+    journal->setSuspended(true);
+    auto treeModel = dynamic_cast<TreePackageDragDropModel*>(treeView->model());
+    // the ids of the crashed session to the ones of the replayed nodes
+    QHash<quint64, quint64> ids;
+    for (const Journal::Entry &entry : entries){
+        switch (entry.op) {
+        case Journal::RESET:
+            tabWidget->resetToDefault();
+            treeModel->resetToDefault();
+            tabWidget->getControlFile()->setPackageName(entry.path);
+            tabWidget->getControlFile()->setVersion(entry.target);
+            ids.clear();
+            ids.insert(entry.node, treeModel->getRoot()->getId());
+            break;
+        case Journal::ADD_FOLDER:
+            ids.insert(entry.node, treeModel->addFolder(ids.value(entry.folder), entry.path.section('/', -1), entry.canRename));
+            break;
+        case Journal::ADD_FILES:
+        {
+            // the signatures are in the journal, the files are not read
+            QVector<FileSignatureInfo*> infos;
+            for (const FileSignatureInfo &fsi : entry.files){
+                infos.append(treeModel->getArena()->createFileSignatureInfo(fsi));
+            }
+            const QVector<quint64> added = treeModel->addFileInfos(ids.value(entry.folder), infos);
+            for (int i=0; i<added.size() && i<entry.ids.size(); i++){
+                ids.insert(entry.ids.at(i), added.at(i));
+            }
+            break;
+        }
+        case Journal::REMOVE:
+            treeModel->removeNode(ids.value(entry.node));
+            break;
+        case Journal::MOVE:
+            treeModel->moveNode(ids.value(entry.node), ids.value(entry.folder));
+            break;
+        case Journal::RENAME:
+            treeModel->renameNode(ids.value(entry.node), entry.target);
+            break;
+        case Journal::ADD_SCRIPT:
+            if (entry.path.contains(".desktop")){
+                tabWidget->addDesktopEdit();
+                treeModel->addDesktopFile(entry.path);
+            } else {
+                tabWidget->addScriptEdit(entry.path);
+                treeModel->addScriptFile(entry.path);
+            }
+            break;
+        case Journal::REMOVE_SCRIPT:
+        {
+            int tab_idx = tabWidget->getIndexByName(entry.path);
+            if (tab_idx != -1)
+                tabWidget->closeScriptTab(tab_idx);
+            break;
+        }
+        case Journal::EDIT_TEXT:
+            tabWidget->applyTextEdit(entry.path, entry.position, entry.removed, entry.target);
+            // the package name is sent once the typing pauses, the records
+            // that follow need the tree and the .desktop tab renamed now
+            if (entry.path == "control")
+                tabWidget->getControlFile()->notifyChanges();
+            break;
+        default:
+            break;
+        }
+    }
+    journal->setSuspended(false);
+    treeView->expandDefault();
+}
+
+void MainWindow::restoreFromJson(const QString &fileName)
+{
+    QFile file(fileName);
+    if (file.open(QIODevice::ReadOnly)){
+        QJsonDocument json_doc(QJsonDocument::fromJson(file.readAll()));
+        file.close();
+        if (!json_doc.isNull()){
+            QJsonObject json_obj = json_doc.object();
+            if (!json_obj.isEmpty()){
+                QVector<QPair<QString, QString> > scripts;
+                QJsonObject scriptObject = json_obj.value("script").toObject();
+                for (const QString &key : scriptObject.keys()){
+                    scripts.append(qMakePair(key, scriptObject.value(key).toString()));
+                }
+                // the signatures are read again by the restorer
+                QVector<RestoreEntry> entries;
+                RestoreEntry entry;
+                entry.cached = false;
+                entry.mode = 0;
+                if (json_obj.contains("files")){
+                    for (const QJsonValue &value : json_obj.value("files").toArray()){
+                        const QJsonObject fileObject = value.toObject();
+                        entry.folder = fileObject.value("folder").toString();
+                        entry.source = fileObject.value("source").toString();
+                        entry.mode = fileObject.value("mode").toInt();
+                        entries.append(entry);
+                    }
+                } else {
+                    // first format, the files were keyed by folder
+                    QJsonObject tree = json_obj.value("tree").toObject();
+                    for (const QString &key : tree.keys()){
+                        entry.folder = key;
+                        entry.source = tree.value(key).toString();
+                        entries.append(entry);
                     }
-                    treeView->expandAll();
                 }
+                storeDir.clear();
+                restoreState(json_obj.value("package").toString(),
+                             json_obj.value("version").toString(),
+                             json_obj.value("control").toString(),
+                             scripts, entries);
             }
         }
     }
 }
 
+void MainWindow::restoreFromBinary(const QString &fileName)
+{
+    ProjectFile project(fileName);
+    if (project.open()){
+        QVector<QPair<QString, QString> > scripts;
+        for (int i=0; i<project.scriptCount(); i++){
+            scripts.append(qMakePair(project.scriptName(i), project.scriptText(i)));
+        }
+        // the signatures are in the project, the files are not read
+        const QString dir = BlobStore::forProject(fileName, project.getPackage());
+        storeDir = QFileInfo::exists(dir) ? dir : QString();
+        BlobStore store(storeDir);
+        QVector<RestoreEntry> entries;
+        entries.reserve(project.fileCount());
+        RestoreEntry entry;
+        entry.cached = true;
+        for (int i=0; i<project.fileCount(); i++){
+            entry.folder = project.fileFolder(i);
+            entry.source = project.fileSource(i);
+            entry.info = project.fileSignature(i);
+            entry.mode = project.fileMode(i);
+            const QString content = entry.info.getContent().c_str();
+            entry.stored = (!storeDir.isEmpty() && !content.isEmpty()) ? store.pathOf(content) : QString();
+            entries.append(entry);
+        }
+        restoreState(project.getPackage(), project.getVersion(), project.getControl(), scripts, entries);
+    } else {
+        QMessageBox::warning(this, tr("Load file"), QString("%1 is not a valid project").arg(fileName));
+    }
+}
+
 void MainWindow::generatePackage()
 {
+    // the tree must have the name being typed
+    tabWidget->getControlFile()->notifyChanges();
+    const ControlParser &control = tabWidget->getControlFile()->getParser();
+    bool generate = true;
+    if (!control.isValid()){
+        QStringList messages;
+        for (const ControlParser::Diagnostic &diagnostic : control.getDiagnostics()){
+            messages.append(diagnostic.message);
+        }
+        generate = QMessageBox::question(this, tr("Generate package"),
+                                         QString("The control file has errors, dpkg-deb may refuse it:\n%1\n\nGenerate anyway?").arg(messages.join("\n")))
+                == QMessageBox::Yes;
+    }
     QString deb_name = tabWidget->getControlFile()->getPackageName() + "_" + tabWidget->getControlFile()->getVersion() + ".deb";
-    deb_name = QFileDialog::getSaveFileName(this, tr("Generate package"), deb_name, tr(".deb file (*.deb)"));
-    if (!deb_name.isNull()){
+    if (generate)
+        deb_name = QFileDialog::getSaveFileName(this, tr("Generate package"), deb_name, tr(".deb file (*.deb)"));
+    if (generate && !deb_name.isNull()){
         auto treeModel = dynamic_cast<TreePackageDragDropModel*>(treeView->model());
         Folder *root = treeModel->getRoot();
+        // one folder per build, a build can start while another runs
         const QString tmp = QDir::tempPath();
-        QDir dir_package(tmp);
-        if (dir_package.mkdir(root->getName().c_str())){
-            if (dir_package.cd(root->getName().c_str())){
-                // create the control file
-                if (dir_package.mkpath("DEBIAN")){
-                    QFile file(dir_package.filePath("DEBIAN/control"));
-                    if (file.open(QIODevice::WriteOnly)){
-                        // the control file has no comment, so remove it
-                        QString clean_control = "";
-                        for (QString line : tabWidget->getControlFile()->toPlainText().split("\n")){
-                            if (!line.startsWith('#'))
-                                clean_control.append(line+"\n");
-                        }
-                        file.write(clean_control.toStdString().c_str());
-                        file.close();
-                    }
+        QTemporaryDir *staging = new QTemporaryDir(tmp+"/"+root->getDisplayName()+"-XXXXXX");
+        QDir dir_package(staging->path());
+        if (staging->isValid() && dir_package.mkdir(root->getDisplayName()) && dir_package.cd(root->getDisplayName())){
+            // create the control file
+            if (dir_package.mkpath("DEBIAN")){
+                QFile file(dir_package.filePath("DEBIAN/control"));
+                if (file.open(QIODevice::WriteOnly)){
+                    // the parsed fields, without the comments
+                    file.write(control.toControl().toUtf8());
+                    file.close();
                 }
-                // create the script files
-                QVector<RealFile*> files_list = treeModel->getFileFromProgram();
-                for (RealFile *f : files_list){
-                    QString fPath;
-                    AbstractFile *parent = f->getParent();
-                    while (parent->getParent() != nullptr){
-                        fPath.prepend(QString(parent->getName().c_str())+"/");
-                        parent = parent->getParent();
-                    }
-                    if (dir_package.mkpath(fPath)){
-                        QFile file(dir_package.filePath(fPath+f->getName().c_str()));
-                        if (file.open(QIODevice::WriteOnly)){
-                            int tab_idx = tabWidget->getIndexByName(f->getName().c_str());
-                            if (tab_idx != -1){
-                                file.write(dynamic_cast<CodeEditor*>(tabWidget->widget(tab_idx))->toPlainText().toStdString().c_str());
-                                file.close();
-                                QProcess *chmod = new QProcess(this);
-                                chmod->start("chmod", QStringList() << "755" << file.fileName());
-                                chmod->waitForFinished(-1);
-                                delete chmod;
-                            }
+            }
+            // create the script files
+            QVector<RealFile*> files_list = treeModel->getFileFromProgram();
+            for (RealFile *f : files_list){
+                const QString fPath = f->getParent()->getInstallPath()+"/";
+                if (dir_package.mkpath(fPath)){
+                    QFile file(dir_package.filePath(fPath+f->getDisplayName()));
+                    if (file.open(QIODevice::WriteOnly)){
+                        int tab_idx = tabWidget->getIndexByName(f->getDisplayName());
+                        if (tab_idx != -1){
+                            file.write(dynamic_cast<CodeEditor*>(tabWidget->widget(tab_idx))->toPlainText().toStdString().c_str());
+                            file.close();
+                            // 755
+                            file.setPermissions(QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner |
+                                                QFile::ReadGroup | QFile::ExeGroup | QFile::ReadOther | QFile::ExeOther);
                         }
                     }
                 }
-                // copy the user files
-                files_list = treeModel->getFileFromUser();
-                for (RealFile *f : files_list){
-                    QString fPath;
-                    AbstractFile *parent = f->getParent();
-                    while (parent->hasParent()){
-                        fPath.prepend(QString(parent->getName().c_str())+"/");
-                        parent = parent->getParent();
-                    }
+            }
+            // copy the user files, from the store when they are in it
+            BlobStore store(storeDir);
+            files_list = treeModel->getFileFromUser();
+            for (RealFile *f : files_list){
+                QString fPath = f->getParent()->getInstallPath()+"/";
 #ifdef USE_TERMUX_PATH
-                    fPath.prepend("data/data/com.termux/files/");
+                fPath.prepend("data/data/com.termux/files/");
 #endif
-                    if (dir_package.mkpath(fPath)){
-                        const QString origin = f->getFileSignatureInfo().getPath().c_str();
-                        QFile::copy(origin, dir_package.filePath(fPath+QFileInfo(origin).fileName()));
+                if (dir_package.mkpath(fPath)){
+                    const QString origin = f->getFileSignatureInfo().getPath().c_str();
+                    const QString content = f->getFileSignatureInfo().getContent().c_str();
+                    const QString destination = dir_package.filePath(fPath+QFileInfo(origin).fileName());
+                    if (!storeDir.isEmpty() && store.contains(content)){
+                        // the stored bytes are shipped, not the current source
+                        if (BlobStore::copy(store.pathOf(content), destination)){
+                            QFile::Permissions mode = QFile::ReadOwner | QFile::WriteOwner | QFile::ReadGroup | QFile::ReadOther;
+                            if (f->getMode())
+                                mode = QFile::Permissions(f->getMode());
+                            else if (QFileInfo::exists(origin))
+                                mode = QFile::permissions(origin);
+                            else if (f->getFileSignatureInfo().getCategory() == FileSignatureInfo::BINARY)
+                                mode |= QFile::ExeOwner | QFile::ExeGroup | QFile::ExeOther;
+                            QFile::setPermissions(destination, mode);
+                        }
+                    } else if (QFile::copy(origin, destination) && f->getMode()){
+                        // the mode saved with the project, not the current one of the source
+                        QFile::setPermissions(destination, QFile::Permissions(f->getMode()));
                     }
                 }
-                // now generate using dpkg-deb --build package_name
-                ProcessDpkgdeb *dpkg_deb = new ProcessDpkgdeb(this);
-                dpkg_deb->generatePackage(tmp+"/"+tabWidget->getControlFile()->getPackageName(), deb_name);
-                dpkg_deb->waitForFinished(-1);
-                delete dpkg_deb;
-                dir_package.cd(tmp+"/"+tabWidget->getControlFile()->getPackageName());
-                dir_package.removeRecursively();
             }
+            // now generate using dpkg-deb --build package_name, the folder
+            // is removed when it is done, see jobFinished
+            JobScheduler::Job job;
+            job.program = "dpkg-deb";
+            job.arguments << "--build" << dir_package.absolutePath() << deb_name;
+            job.priority = JobScheduler::HIGH;
+            builds.insert(jobs->submit(job), staging);
+            // much faster than the build, the issues come while it runs
+            checkPackage();
         } else {
-            QMessageBox::warning(this, tr("Mkdir"), QString("Can't create path %1").arg(tmp, "/", root->getName().c_str()));
+            QMessageBox::warning(this, tr("Mkdir"), QString("Can't create path %1/%2").arg(staging->isValid() ? staging->path() : tmp, root->getDisplayName()));
+            delete staging;
         }
     }
 }
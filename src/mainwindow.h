@@ -2,15 +2,29 @@
 #define MAINWINDOW_H
 
 #include <QMainWindow>
+#include <QPair>
+#include <QVector>
+#include <QStringList>
+#include <QHash>
+#include "journal.h"
+#include "jobscheduler.h"
+#include "packagelinter.h"
 
 class QListView;
+class QListWidget;
 class QGridLayout;
 class QSplitter;
 class QToolButton;
+class QLineEdit;
+class QVBoxLayout;
+class QThread;
+class QTemporaryDir;
 class ScripEditorTabWidget;
 class TreeView;
 class MenuFile;
 class MenuHelp;
+class ProjectRestorer;
+struct RestoreEntry;
 
 namespace Ui {
 class MainWindow;
@@ -26,11 +40,31 @@ public:
     static const QString version;
 
 public slots:
-    void saveToJson();
-    void restoreFromJson();
+    void saveProject();
+    void restoreProject();
     void generatePackage();
+    void checkPackage();
+
+private slots:
+    void projectRestored();
+    void filesStored();
+    void recoverSession();
+    void compactJournal();
+    void jobFinished(const JobScheduler::Result &result);
+    void addLintIssues(int lint, const QVector<LintIssue> &issues);
+    void lintFinished();
 
 private:
+    QVector<QPair<QString, QString> > getScripts();
+    bool saveToJson(const QString& fileName);
+    bool saveToBinary(const QString& fileName);
+    void restoreState(const QString& package, const QString& version, const QString& control, const QVector<QPair<QString, QString> >& scripts,
+                      const QVector<RestoreEntry>& entries);
+    void restoreFromJson(const QString& fileName);
+    void restoreFromBinary(const QString& fileName);
+    void replayJournal(const QVector<Journal::Entry>& entries);
+    void storeFiles(const QString& dir, const QString& project);
+    void setProjectActionsEnabled(bool enabled);
     Ui::MainWindow *ui;
     QAction *actionQuit;
     QToolButton *toolScript;
@@ -39,8 +73,25 @@ private:
 
     QGridLayout *gLayout;
     QSplitter *splitter;
+    QSplitter *editorSplitter;
     ScripEditorTabWidget *tabWidget;
+    // the issues of the last PackageLinter
+    QListWidget *lintList;
+    int lint;
     TreeView *treeView;
+    QWidget *treePanel;
+    QVBoxLayout *treeLayout;
+    QLineEdit *searchEdit;
+    ProjectRestorer *restorer;
+    QStringList restoredScripts;
+    Journal *journal;
+    // BlobStore of the last saved or restored project, empty if none
+    QString storeDir;
+    // the files copied to the store before the project is written
+    QThread *storing;
+    JobScheduler *jobs;
+    // the package folder of the dpkg-deb jobs, removed once built
+    QHash<int, QTemporaryDir*> builds;
 
 };
 
@@ -22,6 +22,11 @@ QMenu *MenuFile::getMenuScript()
     return menuScript;
 }
 
+bool MenuFile::isStoreEnabled() const
+{
+    return actionStoreFiles->isChecked();
+}
+
 void MenuFile::actionScriptTriggered()
 {
     QObject *action = QObject::sender();
@@ -55,6 +60,11 @@ void MenuFile::actionGeneratePackageTriggered()
     emit wantGeneratePackage();
 }
 
+void MenuFile::actionCheckPackageTriggered()
+{
+    emit wantCheckPackage();
+}
+
 void MenuFile::init()
 {
     setTitle("File");
@@ -66,9 +76,13 @@ void MenuFile::init()
 
     actionDesktop = addAction(QIcon("://icon/desktop.png"), "Add .desktop file");
     actionGeneratePackage = addAction(QIcon("://icon/generate.png"), "Generate package");
+    actionCheckPackage = addAction("Check package");
     addSeparator();
     actionSavePackageProject = addAction(QIcon("://icon/diskette.png"), "Save config");
     actionImportPackageProject = addAction(QIcon("://icon/import.png"), "Import config");
+    // the saved project keeps a copy of the files, see BlobStore
+    actionStoreFiles = addAction("Store files with the config");
+    actionStoreFiles->setCheckable(true);
 
     connect(actionPostinst, SIGNAL(triggered(bool)), this, SLOT(actionScriptTriggered()));
     connect(actionPreinst, SIGNAL(triggered(bool)), this, SLOT(actionScriptTriggered()));
@@ -77,6 +91,7 @@ void MenuFile::init()
     connect(actionDesktop, SIGNAL(triggered(bool)), this, SLOT(actionDesktopTriggered()));
 
     connect(actionGeneratePackage, SIGNAL(triggered(bool)), this, SLOT(actionGeneratePackageTriggered()));
+    connect(actionCheckPackage, SIGNAL(triggered(bool)), this, SLOT(actionCheckPackageTriggered()));
     connect(actionSavePackageProject, SIGNAL(triggered(bool)), this, SLOT(actionSavePackageProjectTriggered()));
     connect(actionImportPackageProject, SIGNAL(triggered(bool)), this, SLOT(actionImportPackageProjectTriggered()));
 }
@@ -16,6 +16,7 @@ public:
     MenuFile(const QString &title, QWidget *parent = Q_NULLPTR);
     ~MenuFile();
     QMenu *getMenuScript();
+    bool isStoreEnabled() const;
 
 signals:
     void wantScript(const QString&);
@@ -23,6 +24,7 @@ signals:
     void savePackageProject();
     void importPackageProject();
     void wantGeneratePackage();
+    void wantCheckPackage();
 
 private slots:
     void actionScriptTriggered();
@@ -30,6 +32,7 @@ private slots:
     void actionSavePackageProjectTriggered();
     void actionImportPackageProjectTriggered();
     void actionGeneratePackageTriggered();
+    void actionCheckPackageTriggered();
 
 private:
     void init();
@@ -41,8 +44,10 @@ private:
 
     QAction *actionDesktop;
     QAction *actionGeneratePackage;
+    QAction *actionCheckPackage;
     QAction *actionSavePackageProject;
     QAction *actionImportPackageProject;
+    QAction *actionStoreFiles;
 
 };
 
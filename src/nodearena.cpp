@@ -0,0 +1,123 @@
+#include "nodearena.h"
+#include "folder.h"
+#include "realfile.h"
+#include "filesignatureinfo.hpp"
+
+namespace {
+// the handles of the files are tagged to know the pool to look in
+const NodeArena::Handle FILE_HANDLE_BIT = NodeArena::Handle(1) << 63;
+}
+
+NodeArena::NodeArena()
+{
+    nextId = 1;
+
+}
+
+NodeArena::~NodeArena()
+{
+    clear();
+}
+
+Folder *NodeArena::createFolder(const std::string &name, bool canRename, std::uint64_t id)
+{
+    Folder *ret = folders.create(name, canRename);
+    assignId(ret, id);
+    return ret;
+}
+
+RealFile *NodeArena::createFile(const std::string &name, bool canRename, FileSignatureInfo *fsi, std::uint64_t id)
+{
+    RealFile *ret = files.create(name, canRename, fsi);
+    assignId(ret, id);
+    return ret;
+}
+
+FileSignatureInfo *NodeArena::createFileSignatureInfo(const std::string &path)
+{
+    return signatures.create(path);
+}
+
+FileSignatureInfo *NodeArena::createFileSignatureInfo(const FileSignatureInfo &info)
+{
+    return signatures.create(info);
+}
+
+void NodeArena::destroy(AbstractFile *af)
+{
+    struct Collector : public AbstractFileVisitor
+    {
+        std::vector<AbstractFile*> nodes;
+        bool visit(Folder *f) { nodes.push_back(f); return true; }
+        void visit(RealFile *rf) { nodes.push_back(rf); }
+    } collector;
+    collector.nodes.push_back(af);
+    if (Folder *f = af->toFolder())
+        f->traverse(collector);
+    // a Folder doesn't own its content, no recursion here
+    for (AbstractFile *node : collector.nodes){
+        ids.erase(node->id);
+        if (Folder *f = node->toFolder()){
+            folders.destroy(f);
+        } else {
+            RealFile *rf = node->toRealFile();
+            if (rf->isFromFileSystem())
+                signatures.destroy(&rf->getFileSignatureInfo());
+            files.destroy(rf);
+        }
+    }
+}
+
+void NodeArena::destroy(FileSignatureInfo *fsi)
+{
+    signatures.destroy(fsi);
+}
+
+NodeArena::Handle NodeArena::handle(AbstractFile *af) const
+{
+    Handle ret;
+    if (Folder *f = af->toFolder())
+        ret = folders.handle(f);
+    else
+        ret = files.handle(af->toRealFile()) | FILE_HANDLE_BIT;
+    return ret;
+}
+
+AbstractFile *NodeArena::resolve(Handle handle) const
+{
+    AbstractFile *ret;
+    if (handle & FILE_HANDLE_BIT)
+        ret = files.resolve(handle & ~FILE_HANDLE_BIT);
+    else
+        ret = folders.resolve(handle);
+    return ret;
+}
+
+AbstractFile *NodeArena::find(std::uint64_t id) const
+{
+    auto it = ids.find(id);
+    return it != ids.end() ? it->second : nullptr;
+}
+
+std::size_t NodeArena::count() const
+{
+    return folders.size() + files.size();
+}
+
+void NodeArena::clear()
+{
+    folders.clear();
+    files.clear();
+    signatures.clear();
+    ids.clear();
+}
+
+void NodeArena::assignId(AbstractFile *af, std::uint64_t id)
+{
+    if (id == 0 || ids.count(id))
+        id = nextId;
+    if (id >= nextId)
+        nextId = id+1;
+    af->id = id;
+    ids.emplace(id, af);
+}
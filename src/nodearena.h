@@ -0,0 +1,51 @@
+#ifndef NODEARENA_H
+#define NODEARENA_H
+
+#include "objectpool.h"
+#include <string>
+#include <unordered_map>
+
+class AbstractFile;
+class Folder;
+class RealFile;
+class FileSignatureInfo;
+
+/**
+ * @brief The NodeArena class
+ * Owns all the nodes of a package tree, allocated in typed pools.
+ * The tree is released in one operation with clear() and nodes
+ * can be referenced by handles that are checked when resolved.
+ */
+
+class NodeArena
+{
+
+public:
+    typedef std::uint64_t Handle;
+
+    NodeArena();
+    ~NodeArena();
+    Folder *createFolder(const std::string& name, bool canRename = true, std::uint64_t id = 0);
+    RealFile *createFile(const std::string& name, bool canRename, FileSignatureInfo *fsi = nullptr, std::uint64_t id = 0);
+    FileSignatureInfo *createFileSignatureInfo(const std::string& path);
+    FileSignatureInfo *createFileSignatureInfo(const FileSignatureInfo& info);
+    void destroy(AbstractFile *af);
+    void destroy(FileSignatureInfo *fsi);
+    Handle handle(AbstractFile *af) const;
+    AbstractFile *resolve(Handle handle) const;
+    AbstractFile *find(std::uint64_t id) const;
+    std::size_t count() const;
+    void clear();
+
+private:
+    void assignId(AbstractFile *af, std::uint64_t id);
+    ObjectPool<Folder> folders;
+    ObjectPool<RealFile> files;
+    ObjectPool<FileSignatureInfo> signatures;
+    // ids are never reused, a snapshot can recreate a node with its id
+    std::uint64_t nextId;
+    std::unordered_map<std::uint64_t, AbstractFile *> ids;
+
+};
+
+#endif // NODEARENA_H
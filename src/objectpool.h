@@ -0,0 +1,143 @@
+#ifndef OBJECTPOOL_H
+#define OBJECTPOOL_H
+
+#include <cstdint>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief The ObjectPool class
+ * Typed pool that allocates objects by chunks, the objects never move
+ * so the pointers stay valid until they are destroyed.
+ * A handle (slot index + generation) identify an object and become
+ * invalid when the object is destroyed, even if its slot is reused.
+ */
+
+template<class T>
+class ObjectPool
+{
+
+public:
+    ObjectPool(std::size_t chunkSize = 1024)
+        : chunkSize(chunkSize), live(0)
+    {
+
+    }
+
+    ~ObjectPool()
+    {
+        clear();
+    }
+
+    template<class... Args>
+    T *create(Args&&... args)
+    {
+        if (freeSlots.empty())
+            grow();
+        Slot *slot = freeSlots.back();
+        T *ret = new (&slot->storage) T(std::forward<Args>(args)...);
+        freeSlots.pop_back();
+        slot->used = true;
+        live++;
+        return ret;
+    }
+
+    void destroy(T *obj)
+    {
+        Slot *slot = slotOf(obj);
+        if (slot->used){
+            obj->~T();
+            slot->used = false;
+            slot->generation++;
+            freeSlots.push_back(slot);
+            live--;
+        }
+    }
+
+    /**
+     * @brief clear
+     * Destroy all the living objects and release the memory in one pass
+     */
+    void clear()
+    {
+        for (Slot *chunk : chunks){
+            for (std::size_t i=0; i<chunkSize; i++){
+                if (chunk[i].used)
+                    reinterpret_cast<T*>(&chunk[i].storage)->~T();
+            }
+            delete [] chunk;
+        }
+        chunks.clear();
+        freeSlots.clear();
+        live = 0;
+    }
+
+    std::uint64_t handle(const T *obj) const
+    {
+        const Slot *slot = slotOf(obj);
+        return (std::uint64_t(slot->index) << 32) | slot->generation;
+    }
+
+    T *resolve(std::uint64_t handle) const
+    {
+        T *ret = nullptr;
+        const std::uint32_t index = std::uint32_t(handle >> 32);
+        const std::size_t chunk = index / chunkSize;
+        if (chunk < chunks.size()){
+            Slot &slot = chunks[chunk][index % chunkSize];
+            if (slot.used && slot.generation == std::uint32_t(handle))
+                ret = reinterpret_cast<T*>(&slot.storage);
+        }
+        return ret;
+    }
+
+    std::size_t size() const
+    {
+        return live;
+    }
+
+private:
+    struct Slot
+    {
+        // must stay the first member, see slotOf()
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+        std::uint32_t index;
+        std::uint32_t generation;
+        bool used;
+    };
+
+    void grow()
+    {
+        Slot *chunk = new Slot[chunkSize];
+        const std::uint32_t first = chunks.size() * chunkSize;
+        chunks.push_back(chunk);
+        // reversed, so the first slots are used first
+        for (std::size_t i=chunkSize; i>0; i--){
+            chunk[i-1].index = first + i - 1;
+            chunk[i-1].generation = 1;
+            chunk[i-1].used = false;
+            freeSlots.push_back(&chunk[i-1]);
+        }
+    }
+
+    static Slot *slotOf(T *obj)
+    {
+        return reinterpret_cast<Slot*>(obj);
+    }
+
+    static const Slot *slotOf(const T *obj)
+    {
+        return reinterpret_cast<const Slot*>(obj);
+    }
+
+    std::size_t chunkSize;
+    std::size_t live;
+    std::vector<Slot*> chunks;
+    std::vector<Slot*> freeSlots;
+
+};
+
+#endif // OBJECTPOOL_H
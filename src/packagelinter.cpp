@@ -0,0 +1,469 @@
+#include "packagelinter.h"
+#include "filesignatureinfo.hpp"
+#include <QFile>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QMutex>
+#include <QRegularExpression>
+#include <QRunnable>
+#include <QSet>
+#include <QStringList>
+#include <QThreadPool>
+#include <QtEndian>
+#include <cstring>
+
+namespace {
+// files checked by a task of the pool
+const int CHUNK_SIZE = 512;
+// the issues are sent at least every BATCH_DELAY ms
+const int BATCH_DELAY = 100;
+// larger .desktop files are not read
+const qint64 MAX_DESKTOP_SIZE = 1024*1024;
+
+const char *const MAINTAINER_SCRIPTS[] = {"preinst", "postinst", "prerm", "postrm", "config"};
+
+// ELF header fields and values
+enum { EI_CLASS = 4, EI_DATA = 5, ELFCLASS32 = 1, ELFCLASS64 = 2, ELFDATA2LSB = 1, ELFDATA2MSB = 2 };
+enum { PT_LOAD = 1, PT_DYNAMIC = 2 };
+enum { DT_NULL = 0, DT_STRTAB = 5, DT_RPATH = 15, DT_RUNPATH = 29 };
+
+struct Item
+{
+    // in the package, the name of a user file is the one of its source
+    QString path;
+    PersistentTree::NodePtr node;
+    // why the folder is outside the FHS, empty if it isn't
+    QString fhs;
+};
+
+struct Shared
+{
+    const PackageLinter *linter;
+    QString architecture;
+    const QHash<QString, QString> *texts;
+    QMutex mutex;
+    QVector<LintIssue> batch;
+};
+
+void addIssue(QVector<LintIssue> &issues, LintIssue::Severity severity, const QString &path, const QString &message)
+{
+    LintIssue issue;
+    issue.severity = severity;
+    issue.path = path;
+    issue.message = message;
+    issues.append(issue);
+}
+
+QString fhsProblem(const QStringList &segments)
+{
+    static const QSet<QString> top = QSet<QString>() << "DEBIAN" << "bin" << "boot" << "etc" << "lib" << "lib32" << "lib64"
+                                                     << "libx32" << "opt" << "sbin" << "srv" << "usr" << "var";
+    static const QSet<QString> usr = QSet<QString>() << "bin" << "games" << "include" << "lib" << "lib32" << "lib64"
+                                                     << "libexec" << "libx32" << "sbin" << "share" << "src";
+    QString ret;
+    if (segments.isEmpty())
+        ret = "Installed at the root of the file system";
+    else if (!top.contains(segments.at(0)))
+        ret = QString("/%1 is not a directory of the FHS for a package").arg(segments.at(0));
+    else if (segments.at(0) == "usr" && segments.size() == 1)
+        ret = "Installed directly in /usr";
+    else if (segments.at(0) == "usr" && segments.at(1) == "local")
+        ret = "A package must not install files in /usr/local";
+    else if (segments.at(0) == "usr" && !usr.contains(segments.at(1)))
+        ret = QString("/usr/%1 is not a directory of the FHS").arg(segments.at(1));
+    return ret;
+}
+
+bool isProgramFolder(const QString &folder)
+{
+    return folder == "bin" || folder == "sbin" || folder == "usr/bin" || folder == "usr/sbin" || folder == "usr/games";
+}
+
+int elfMachine(const QString &architecture)
+{
+    // e_machine of the Debian architectures
+    static const QHash<QString, int> machines = [](){
+        QHash<QString, int> ret;
+        ret.insert("i386", 3);
+        ret.insert("amd64", 62);
+        ret.insert("armel", 40);
+        ret.insert("armhf", 40);
+        ret.insert("arm64", 183);
+        ret.insert("mips", 8);
+        ret.insert("mipsel", 8);
+        ret.insert("mips64el", 8);
+        ret.insert("ppc64el", 21);
+        ret.insert("ppc64", 21);
+        ret.insert("powerpc", 20);
+        ret.insert("s390x", 22);
+        ret.insert("riscv64", 243);
+        return ret;
+    }();
+    // 0 for the architectures not known here
+    return machines.value(architecture, 0);
+}
+
+class ElfReader
+{
+public:
+    ElfReader(const uchar *data, qint64 size)
+        : data(data), size(size), valid(size >= 64 && memcmp(data, "\x7f" "ELF", 4) == 0)
+    {
+        is64 = valid && data[EI_CLASS] == ELFCLASS64;
+        bigEndian = valid && data[EI_DATA] == ELFDATA2MSB;
+        valid = valid && (data[EI_CLASS] == ELFCLASS32 || is64) && (data[EI_DATA] == ELFDATA2LSB || bigEndian);
+    }
+
+    bool isValid() const
+    {
+        return valid;
+    }
+
+    int machine() const
+    {
+        return read(18, 2);
+    }
+
+    // the DT_RPATH and DT_RUNPATH strings
+    QStringList rpaths() const
+    {
+        QStringList ret;
+        const quint64 phoff = is64 ? read(32, 8) : read(28, 4);
+        const quint64 phentsize = read(is64 ? 54 : 42, 2);
+        // the offsets and sizes of the headers are checked before use,
+        // a malformed file must not be read outside its mapping
+        const quint64 count = read(is64 ? 56 : 44, 2);
+        const quint64 phnum = inFile(phoff, count*phentsize) ? count : 0;
+        quint64 dynamic = 0;
+        quint64 dynamicSize = 0;
+        for (quint64 i=0; i<phnum; i++){
+            const quint64 ph = phoff + i*phentsize;
+            if (read(ph, 4) == PT_DYNAMIC){
+                dynamic = is64 ? read(ph+8, 8) : read(ph+4, 4);
+                dynamicSize = is64 ? read(ph+32, 8) : read(ph+16, 4);
+            }
+        }
+        // the string table is given by its address
+        const quint64 entrySize = is64 ? 16 : 8;
+        quint64 strtab = 0;
+        QVector<quint64> paths;
+        bool end = dynamicSize == 0 || !inFile(dynamic, dynamicSize);
+        for (quint64 entry = dynamic; !end && entry+entrySize <= dynamic+dynamicSize; entry += entrySize){
+            const quint64 tag = is64 ? read(entry, 8) : read(entry, 4);
+            const quint64 value = is64 ? read(entry+8, 8) : read(entry+4, 4);
+            end = tag == DT_NULL;
+            if (tag == DT_STRTAB)
+                strtab = offsetOf(value, phoff, phentsize, phnum);
+            else if (tag == DT_RPATH || tag == DT_RUNPATH)
+                paths.append(value);
+        }
+        for (quint64 path : paths){
+            if (strtab > 0 && inFile(strtab, path)){
+                const quint64 start = strtab + path;
+                quint64 stop = start;
+                while (stop < quint64(size) && data[stop] != 0){
+                    stop++;
+                }
+                if (stop < quint64(size))
+                    ret.append(QString::fromLatin1(reinterpret_cast<const char*>(data+start), int(stop-start)));
+            }
+        }
+        return ret;
+    }
+
+private:
+    bool inFile(quint64 offset, quint64 bytes) const
+    {
+        // offset+bytes could wrap around
+        return offset <= quint64(size) && bytes <= quint64(size)-offset;
+    }
+
+    quint64 read(quint64 offset, int bytes) const
+    {
+        quint64 ret = 0;
+        if (inFile(offset, bytes)){
+            const uchar *p = data+offset;
+            switch (bytes) {
+            case 2:
+                ret = bigEndian ? qFromBigEndian<quint16>(p) : qFromLittleEndian<quint16>(p);
+                break;
+            case 4:
+                ret = bigEndian ? qFromBigEndian<quint32>(p) : qFromLittleEndian<quint32>(p);
+                break;
+            default:
+                ret = bigEndian ? qFromBigEndian<quint64>(p) : qFromLittleEndian<quint64>(p);
+                break;
+            }
+        }
+        return ret;
+    }
+
+    quint64 offsetOf(quint64 address, quint64 phoff, quint64 phentsize, quint64 phnum) const
+    {
+        // in the loaded segment holding the address
+        quint64 ret = 0;
+        for (quint64 i=0; i<phnum && ret == 0; i++){
+            const quint64 ph = phoff + i*phentsize;
+            if (read(ph, 4) == PT_LOAD){
+                const quint64 offset = is64 ? read(ph+8, 8) : read(ph+4, 4);
+                const quint64 vaddr = is64 ? read(ph+16, 8) : read(ph+8, 4);
+                const quint64 filesz = is64 ? read(ph+32, 8) : read(ph+16, 4);
+                if (address >= vaddr && address-vaddr < filesz && inFile(offset, filesz))
+                    ret = offset + (address-vaddr);
+            }
+        }
+        return ret;
+    }
+
+    const uchar *data;
+    qint64 size;
+    bool valid;
+    bool is64;
+    bool bigEndian;
+};
+
+void lintDesktop(const QString &text, const QString &path, QVector<LintIssue> &issues)
+{
+    // Key or Key[locale]
+    static const QRegularExpression keyPattern("^[A-Za-z0-9-]+(\\[[^\\]]+\\])?$");
+    // the keys of the [Desktop Entry] group
+    QSet<QString> keys;
+    QString type;
+    QString group;
+    bool started = false;
+    const QStringList lines = text.split('\n');
+    for (int i=0; i<lines.size(); i++){
+        const QString line = lines.at(i).trimmed();
+        if (line.isEmpty() || line.startsWith('#')){
+            // nothing to check
+        } else if (!started && line != "[Desktop Entry]"){
+            addIssue(issues, LintIssue::ERROR, path, "The file must start with the [Desktop Entry] group");
+            started = true;
+        } else if (line.startsWith('[')){
+            if (!line.endsWith(']'))
+                addIssue(issues, LintIssue::ERROR, path, QString("Line %1: the group header is not closed").arg(i+1));
+            group = line.mid(1, line.size()-2);
+            started = true;
+        } else {
+            const int equal = line.indexOf('=');
+            const QString key = line.left(equal).trimmed();
+            if (equal <= 0 || !keyPattern.match(key).hasMatch()){
+                addIssue(issues, LintIssue::ERROR, path, QString("Line %1: expected Key=Value").arg(i+1));
+            } else if (group == "Desktop Entry"){
+                if (keys.contains(key))
+                    addIssue(issues, LintIssue::ERROR, path, QString("Line %1: duplicate key %2").arg(i+1).arg(key));
+                keys.insert(key);
+                if (key == "Type")
+                    type = line.mid(equal+1).trimmed();
+            }
+        }
+    }
+    if (!keys.contains("Type"))
+        addIssue(issues, LintIssue::ERROR, path, "Missing key Type");
+    if (!keys.contains("Name"))
+        addIssue(issues, LintIssue::ERROR, path, "Missing key Name");
+    if (type == "Application" && !keys.contains("Exec"))
+        addIssue(issues, LintIssue::ERROR, path, "An Application needs an Exec key");
+}
+
+bool isMaintainerScript(const QString &name)
+{
+    bool ret = false;
+    for (const char *script : MAINTAINER_SCRIPTS){
+        ret = ret || name == script;
+    }
+    return ret;
+}
+
+void lintProgramFile(const Item &item, const QString &folder, const Shared &shared, QVector<LintIssue> &issues)
+{
+    // the text is in a tab, written with the package
+    const QString name = item.node->name.qstr();
+    const QString text = shared.texts->value(name);
+    if (folder == "DEBIAN"){
+        // written with the mode 755, the kernel still needs the interpreter
+        if (isMaintainerScript(name) && !text.startsWith("#!"))
+            addIssue(issues, LintIssue::ERROR, item.path, "A maintainer script must start with a #! line");
+    } else if (name.endsWith(".desktop")){
+        lintDesktop(text, item.path, issues);
+    }
+}
+
+QFile::Permissions packageMode(const PersistentTree::Node &node, const QString &origin)
+{
+    // as MainWindow::generatePackage: the mode saved with the project, or
+    // the one of the source, a stored binary whose source is gone is executable
+    QFile::Permissions ret = QFile::ReadOwner | QFile::WriteOwner | QFile::ReadGroup | QFile::ReadOther;
+    if (node.mode)
+        ret = QFile::Permissions(node.mode);
+    else if (QFileInfo::exists(origin))
+        ret = QFile::permissions(origin);
+    else if (!node.stored.empty() && node.info->getCategory() == FileSignatureInfo::BINARY)
+        ret |= QFile::ExeOwner | QFile::ExeGroup | QFile::ExeOther;
+    return ret;
+}
+
+void lintUserFile(const Item &item, const QString &folder, const Shared &shared, QVector<LintIssue> &issues)
+{
+    FileSignatureInfo &fsi = *item.node->info;
+    // the bytes shipped, the name in the package is the one of the origin
+    const QString origin = QString::fromStdString(fsi.getPath());
+    const QString source = item.node->stored.empty() ? origin : QString::fromStdString(item.node->stored);
+    const QFileInfo info(source);
+    const bool exists = info.exists();
+    const bool executable = exists && (packageMode(*item.node, origin) & QFile::ExeOwner);
+    const QString name = QFileInfo(origin).fileName();
+
+    if (folder == "DEBIAN" && exists){
+        const bool script = isMaintainerScript(name);
+        if (script && !executable)
+            addIssue(issues, LintIssue::ERROR, item.path, "A maintainer script must be executable (755)");
+        else if (!script && executable)
+            addIssue(issues, LintIssue::WARNING, item.path, "Only the maintainer scripts should be executable in DEBIAN");
+    } else if (isProgramFolder(folder) && exists && !executable){
+        addIssue(issues, LintIssue::WARNING, item.path, QString("Not executable in /%1").arg(folder));
+    }
+
+    if (folder.startsWith("usr/share/icons/hicolor/")){
+        // usr/share/icons/hicolor/<size>/<context>
+        const QString size = folder.section('/', 4, 4);
+        if (size == "scalable"){
+            if (!name.endsWith(".svg") && !name.endsWith(".svgz"))
+                addIssue(issues, LintIssue::ERROR, item.path, "Only the SVG icons go in the scalable folder");
+        } else if (exists && fsi.getCategory() == FileSignatureInfo::IMAGE){
+            // 48x48 or 48x48@2
+            static const QRegularExpression sizePattern("^(\\d+)x(\\d+)(@\\d+)?$");
+            const QRegularExpressionMatch match = sizePattern.match(size);
+            const int scale = match.captured(3).isEmpty() ? 1 : match.captured(3).mid(1).toInt();
+            const QSize expected = match.hasMatch() ? QSize(match.captured(1).toInt(), match.captured(2).toInt())*scale : QSize();
+            const QSize actual = expected.isValid() ? QImageReader(source).size() : QSize();
+            if (actual.isValid() && actual != expected)
+                addIssue(issues, LintIssue::ERROR, item.path, QString("The icon is %1x%2, not %3").arg(actual.width()).arg(actual.height()).arg(size));
+        }
+    }
+
+    if (folder == "usr/share/applications" && name.endsWith(".desktop") && exists && info.size() <= MAX_DESKTOP_SIZE){
+        QFile file(source);
+        if (file.open(QIODevice::ReadOnly))
+            lintDesktop(QString::fromUtf8(file.readAll()), item.path, issues);
+    }
+
+    if (fsi.getCategory() == FileSignatureInfo::BINARY && exists){
+        QFile file(source);
+        uchar *data = Q_NULLPTR;
+        if (file.open(QIODevice::ReadOnly))
+            data = file.map(0, file.size());
+        const ElfReader elf(data, data ? file.size() : 0);
+        if (elf.isValid()){
+            const int machine = elfMachine(shared.architecture);
+            if (shared.architecture == "all")
+                addIssue(issues, LintIssue::ERROR, item.path, "An ELF binary in a package of architecture all");
+            else if (machine != 0 && machine != elf.machine())
+                addIssue(issues, LintIssue::ERROR, item.path, QString("The ELF binary isn't built for %1").arg(shared.architecture));
+            for (const QString &rpath : elf.rpaths()){
+                addIssue(issues, LintIssue::WARNING, item.path, QString("The binary sets an RPATH: %1").arg(rpath));
+            }
+        }
+    }
+}
+
+class LintTask : public QRunnable
+{
+public:
+    LintTask(const Item *first, const Item *last, Shared *shared)
+        : first(first), last(last), shared(shared)
+    {
+
+    }
+
+    void run()
+    {
+        QVector<LintIssue> issues;
+        for (const Item *item = first; item != last && !shared->linter->isInterruptionRequested(); item++){
+            const QString folder = item->path.section('/', 0, -2);
+            if (!item->fhs.isEmpty())
+                addIssue(issues, LintIssue::WARNING, item->path, item->fhs);
+            if (item->node->info)
+                lintUserFile(*item, folder, *shared, issues);
+            else
+                lintProgramFile(*item, folder, *shared, issues);
+        }
+        if (!issues.isEmpty()){
+            QMutexLocker lock(&shared->mutex);
+            shared->batch += issues;
+        }
+    }
+
+private:
+    const Item *first;
+    const Item *last;
+    Shared *shared;
+};
+
+void collect(const PersistentTree::NodePtr &node, const QString &path, const QStringList &segments, QVector<Item> &items)
+{
+    // the FHS is checked once per folder
+    const QString fhs = fhsProblem(segments);
+    for (const PersistentTree::NodePtr &c : node->children){
+        if (c->folder){
+            collect(c, path+c->name.qstr()+"/", QStringList(segments) << c->name.qstr(), items);
+        } else {
+            Item item;
+            item.path = path + (c->info ? QFileInfo(QString::fromStdString(c->info->getPath())).fileName() : c->name.qstr());
+            item.node = c;
+            item.fhs = fhs;
+            items.append(item);
+        }
+    }
+}
+}
+
+PackageLinter::PackageLinter(int lint, const PersistentTree::NodePtr &root, const QString &architecture,
+                             const QHash<QString, QString> &texts, QObject *parent)
+    : QThread(parent)
+{
+    this->lint = lint;
+    this->root = root;
+    this->architecture = architecture;
+    this->texts = texts;
+}
+
+PackageLinter::~PackageLinter()
+{
+    requestInterruption();
+    wait();
+}
+
+int PackageLinter::getLint() const
+{
+    return lint;
+}
+
+void PackageLinter::run()
+{
+    QVector<Item> items;
+    if (root)
+        collect(root, QString(), QStringList(), items);
+    Shared shared;
+    shared.linter = this;
+    shared.architecture = architecture;
+    shared.texts = &texts;
+    // the items are not resized, the tasks read them in place
+    QThreadPool pool;
+    pool.setMaxThreadCount(QThread::idealThreadCount());
+    const Item *data = items.constData();
+    for (int i=0; i<items.size(); i+=CHUNK_SIZE){
+        pool.start(new LintTask(data+i, data+qMin(i+CHUNK_SIZE, items.size()), &shared));
+    }
+    // the issues found so far are sent while the tasks go on
+    bool done = false;
+    while (!done){
+        done = pool.waitForDone(BATCH_DELAY);
+        QVector<LintIssue> issues;
+        shared.mutex.lock();
+        issues.swap(shared.batch);
+        shared.mutex.unlock();
+        if (!issues.isEmpty() && !isInterruptionRequested())
+            emit issuesFound(lint, issues);
+    }
+}
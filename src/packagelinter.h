@@ -0,0 +1,58 @@
+#ifndef PACKAGELINTER_H
+#define PACKAGELINTER_H
+
+#include "persistenttree.h"
+#include <QThread>
+#include <QHash>
+#include <QVector>
+#include <QMetaType>
+
+/**
+ * @brief The LintIssue struct
+ * A problem found in the package by the PackageLinter
+ */
+
+struct LintIssue
+{
+    enum Severity { WARNING=0, ERROR };
+    Severity severity;
+    // in the package, "usr/bin/program"
+    QString path;
+    QString message;
+};
+
+Q_DECLARE_METATYPE(LintIssue)
+
+/**
+ * @brief The PackageLinter class
+ * Check a snapshot of the live package tree in background, without lintian:
+ * modes of the scripts and of the programs, .desktop files, hicolor
+ * icon sizes, ELF architecture and RPATH, paths outside the FHS.
+ * The files are checked in parallel, the issues are sent by batches.
+ */
+
+class PackageLinter : public QThread
+{
+    Q_OBJECT
+public:
+    // texts: the files written by the program (scripts, .desktop) by name
+    PackageLinter(int lint, const PersistentTree::NodePtr& root, const QString& architecture,
+                  const QHash<QString, QString>& texts, QObject *parent = Q_NULLPTR);
+    ~PackageLinter();
+    int getLint() const;
+
+signals:
+    void issuesFound(int lint, const QVector<LintIssue> &issues);
+
+protected:
+    virtual void run();
+
+private:
+    int lint;
+    PersistentTree::NodePtr root;
+    QString architecture;
+    QHash<QString, QString> texts;
+
+};
+
+#endif // PACKAGELINTER_H
@@ -0,0 +1,115 @@
+#include "persistenttree.h"
+#include "folder.h"
+#include "realfile.h"
+#include "filesignatureinfo.hpp"
+#include <algorithm>
+
+PersistentTree::PersistentTree()
+{
+
+}
+
+PersistentTree::NodePtr PersistentTree::snapshot() const
+{
+    return root;
+}
+
+void PersistentTree::reset(const NodePtr &root)
+{
+    this->root = root;
+}
+
+void PersistentTree::add(Folder *parent, const std::vector<AbstractFile *> &children)
+{
+    // all the children of a batch are added with one copy of the path
+    std::vector<NodePtr> nodes;
+    for (AbstractFile *af : children)
+        nodes.push_back(build(af));
+    update(parent, [&nodes](const NodePtr& node) {
+        Node *copy = new Node(*node);
+        copy->children.insert(copy->children.end(), nodes.begin(), nodes.end());
+        return NodePtr(copy);
+    });
+}
+
+void PersistentTree::remove(AbstractFile *af)
+{
+    // to call before the node is removed from its parent
+    const std::uint64_t id = af->getId();
+    if (af->getParent()){
+        update(af->getParent(), [id](const NodePtr& node) {
+            NodePtr ret = node;
+            auto it = std::find_if(node->children.begin(), node->children.end(),
+                                   [id](const NodePtr& c) { return c->id == id; });
+            if (it != node->children.end()){
+                Node *copy = new Node(*node);
+                copy->children.erase(copy->children.begin() + (it - node->children.begin()));
+                ret = NodePtr(copy);
+            }
+            return ret;
+        });
+    }
+}
+
+void PersistentTree::rename(AbstractFile *af)
+{
+    const InternedName name(af->getName());
+    update(af, [&name](const NodePtr& node) {
+        Node *copy = new Node(*node);
+        copy->name = name;
+        return NodePtr(copy);
+    });
+}
+
+PersistentTree::NodePtr PersistentTree::build(AbstractFile *af, const StoreLookup &stored)
+{
+    Node *ret = new Node();
+    ret->id = af->getId();
+    ret->name = InternedName(af->getName());
+    ret->folder = af->isFolder();
+    ret->canRename = af->isRenamable();
+    ret->mode = 0;
+    if (Folder *f = af->toFolder()){
+        for (int i=0; i<f->count(false); i++)
+            ret->children.push_back(build(f->child(i), stored));
+    } else if (af->toRealFile()->isFromFileSystem()){
+        ret->info = std::make_shared<FileSignatureInfo>(af->toRealFile()->getFileSignatureInfo());
+        ret->mode = af->toRealFile()->getMode();
+        if (stored)
+            ret->stored = stored(*ret->info);
+    }
+    return NodePtr(ret);
+}
+
+void PersistentTree::update(AbstractFile *af, const Edit &edit)
+{
+    // ids from the child of the root down to af
+    std::vector<std::uint64_t> chain;
+    for (AbstractFile *current = af; current->getParent(); current = current->getParent())
+        chain.push_back(current->getId());
+    std::reverse(chain.begin(), chain.end());
+    if (root)
+        root = update(root, chain, 0, edit);
+}
+
+PersistentTree::NodePtr PersistentTree::update(const NodePtr &node, const std::vector<std::uint64_t> &chain, std::size_t depth, const Edit &edit)
+{
+    // unchanged if the path isn't mirrored (DEBIAN, files of the program)
+    NodePtr ret = node;
+    if (depth == chain.size()){
+        ret = edit(node);
+    } else {
+        for (std::size_t i=0; i<node->children.size(); i++){
+            if (node->children[i]->id == chain[depth]){
+                NodePtr c = update(node->children[i], chain, depth+1, edit);
+                if (c != node->children[i]){
+                    Node *copy = new Node(*node);
+                    copy->children[i] = c;
+                    ret = NodePtr(copy);
+                }
+                break;
+            }
+        }
+    }
+    return ret;
+}
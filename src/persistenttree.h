@@ -0,0 +1,63 @@
+#ifndef PERSISTENTTREE_H
+#define PERSISTENTTREE_H
+
+#include "internedname.h"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+class AbstractFile;
+class Folder;
+class FileSignatureInfo;
+
+/**
+ * @brief The PersistentTree class
+ * Immutable copy of the package tree that follows its edits. An edit
+ * copies the nodes from the root to the edited one and shares all the
+ * others, so a snapshot is the root pointer and can be kept for undo
+ * or read from another thread while the tree is still edited.
+ * The nodes are identified by the id of the AbstractFile they mirror.
+ */
+
+class PersistentTree
+{
+
+public:
+    struct Node;
+    typedef std::shared_ptr<const Node> NodePtr;
+
+    struct Node
+    {
+        std::uint64_t id;
+        InternedName name;
+        bool folder;
+        bool canRename;
+        // null if the file isn't from the filesystem, never modified
+        std::shared_ptr<FileSignatureInfo> info;
+        unsigned int mode;
+        // the copy shipped instead of the source, empty if none
+        std::string stored;
+        std::vector<NodePtr> children;
+    };
+
+    PersistentTree();
+    NodePtr snapshot() const;
+    void reset(const NodePtr& root);
+    void add(Folder *parent, const std::vector<AbstractFile *>& children);
+    void remove(AbstractFile *af);
+    void rename(AbstractFile *af);
+    // stored: where the bytes of a file are kept, not looked up if null
+    typedef std::function<std::string(FileSignatureInfo&)> StoreLookup;
+    static NodePtr build(AbstractFile *af, const StoreLookup& stored = StoreLookup());
+
+private:
+    typedef std::function<NodePtr(const NodePtr&)> Edit;
+    void update(AbstractFile *af, const Edit& edit);
+    static NodePtr update(const NodePtr& node, const std::vector<std::uint64_t>& chain, std::size_t depth, const Edit& edit);
+    NodePtr root;
+
+};
+
+#endif // PERSISTENTTREE_H
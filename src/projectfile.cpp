@@ -0,0 +1,261 @@
+#include "projectfile.h"
+#include "realfile.h"
+#include <QHash>
+#include <QSaveFile>
+#include <QtEndian>
+#include <cstring>
+
+namespace {
+const char MAGIC[4] = {'D', 'P', 'K', 'P'};
+
+// header fields, all little endian
+enum {
+    H_MAGIC = 0, H_VERSION = 4, H_STRING_COUNT = 8, H_SCRIPT_COUNT = 12, H_FILE_COUNT = 16,
+    H_PACKAGE = 20, H_PACKAGE_VERSION = 24, H_CONTROL = 28,
+    H_STRINGS = 32, H_BLOB = 36, H_SCRIPTS = 40, H_FILES = 44, HEADER_SIZE = 48
+};
+// string: offset in the blob, length of the UTF-8 bytes
+const int STRING_SIZE = 8;
+// script: name, text
+const int SCRIPT_SIZE = 8;
+// file: folder, source, mode, category, size (64 bits), signature,
+// content hash in the BlobStore (string id + 1, 0 if not stored)
+enum {
+    F_FOLDER = 0, F_SOURCE = 4, F_MODE = 8, F_CATEGORY = 12, F_SIZE = 16, F_SIGNATURE = 24, F_CONTENT = 28, FILE_SIZE = 32
+};
+
+class StringTable
+{
+public:
+    quint32 add(const QString& str)
+    {
+        auto it = ids.find(str);
+        if (it == ids.end()){
+            it = ids.insert(str, strings.size());
+            strings.append(str.toUtf8());
+        }
+        return it.value();
+    }
+    QHash<QString, quint32> ids;
+    QVector<QByteArray> strings;
+};
+
+void append32(QByteArray& out, quint32 value)
+{
+    uchar buffer[4];
+    qToLittleEndian(value, buffer);
+    out.append(reinterpret_cast<const char*>(buffer), 4);
+}
+
+void append64(QByteArray& out, quint64 value)
+{
+    uchar buffer[8];
+    qToLittleEndian(value, buffer);
+    out.append(reinterpret_cast<const char*>(buffer), 8);
+}
+}
+
+const quint32 ProjectFile::formatVersion = 1;
+
+bool ProjectFile::isProjectFile(const QString &fileName)
+{
+    bool ret = false;
+    QFile file(fileName);
+    if (file.open(QIODevice::ReadOnly)){
+        ret = file.read(sizeof(MAGIC)) == QByteArray(MAGIC, sizeof(MAGIC));
+        file.close();
+    }
+    return ret;
+}
+
+bool ProjectFile::write(const QString &fileName, const QString &package, const QString &version, const QString &control,
+                        const QVector<QPair<QString, QString> > &scripts, const QVector<RealFile *> &files)
+{
+    bool ret = false;
+    StringTable table;
+    QByteArray scriptRecords;
+    for (const QPair<QString, QString> &script : scripts){
+        append32(scriptRecords, table.add(script.first));
+        append32(scriptRecords, table.add(script.second));
+    }
+    QByteArray fileRecords;
+    for (RealFile *rf : files){
+        FileSignatureInfo &fsi = rf->getFileSignatureInfo();
+        const QString source = QString::fromStdString(fsi.getPath());
+        append32(fileRecords, table.add(rf->getParent()->getInstallPath()));
+        append32(fileRecords, table.add(source));
+        // a restored file keeps its saved mode, its source may be gone
+        append32(fileRecords, rf->getMode() ? rf->getMode() : quint32(QFile::permissions(source)));
+        append32(fileRecords, quint32(fsi.getCategory()));
+        append64(fileRecords, quint64(fsi.getSize()));
+        append32(fileRecords, table.add(QString::fromStdString(fsi.getHex_signature())));
+        const std::string content = fsi.getContent();
+        append32(fileRecords, content.empty() ? 0 : table.add(QString::fromStdString(content))+1);
+    }
+    const quint32 package_id = table.add(package);
+    const quint32 version_id = table.add(version);
+    const quint32 control_id = table.add(control);
+
+    QByteArray strings;
+    QByteArray blob;
+    for (const QByteArray &str : table.strings){
+        append32(strings, blob.size());
+        append32(strings, str.size());
+        blob.append(str);
+    }
+    QByteArray header(MAGIC, sizeof(MAGIC));
+    append32(header, formatVersion);
+    append32(header, table.strings.size());
+    append32(header, scripts.size());
+    append32(header, files.size());
+    append32(header, package_id);
+    append32(header, version_id);
+    append32(header, control_id);
+    // the records first, they stay aligned
+    const quint32 scripts_offset = HEADER_SIZE;
+    const quint32 files_offset = scripts_offset + scriptRecords.size();
+    const quint32 strings_offset = files_offset + fileRecords.size();
+    const quint32 blob_offset = strings_offset + strings.size();
+    append32(header, strings_offset);
+    append32(header, blob_offset);
+    append32(header, scripts_offset);
+    append32(header, files_offset);
+
+    QSaveFile out(fileName);
+    if (out.open(QIODevice::WriteOnly)){
+        out.write(header);
+        out.write(scriptRecords);
+        out.write(fileRecords);
+        out.write(strings);
+        out.write(blob);
+        ret = out.commit();
+    }
+    return ret;
+}
+
+ProjectFile::ProjectFile(const QString &fileName)
+    : file(fileName), data(Q_NULLPTR), size(0)
+{
+
+}
+
+ProjectFile::~ProjectFile()
+{
+    // the mapping is released with the QFile
+}
+
+bool ProjectFile::open()
+{
+    bool ret = false;
+    if (file.open(QIODevice::ReadOnly)){
+        size = file.size();
+        if (size >= HEADER_SIZE)
+            data = file.map(0, size);
+        // the mapping stays valid once the file is closed
+        file.close();
+    }
+    if (data && memcmp(data, MAGIC, sizeof(MAGIC)) == 0 && read32(H_VERSION) == formatVersion){
+        // all the tables must be in the file, a string is checked when decoded
+        const qint64 strings_end = qint64(read32(H_STRINGS)) + qint64(read32(H_STRING_COUNT))*STRING_SIZE;
+        const qint64 scripts_end = qint64(read32(H_SCRIPTS)) + qint64(read32(H_SCRIPT_COUNT))*SCRIPT_SIZE;
+        const qint64 files_end = qint64(read32(H_FILES)) + qint64(read32(H_FILE_COUNT))*FILE_SIZE;
+        ret = strings_end <= size && scripts_end <= size && files_end <= size && read32(H_BLOB) <= size;
+    }
+    return ret;
+}
+
+QString ProjectFile::getPackage() const
+{
+    return string(read32(H_PACKAGE));
+}
+
+QString ProjectFile::getVersion() const
+{
+    return string(read32(H_PACKAGE_VERSION));
+}
+
+QString ProjectFile::getControl() const
+{
+    return string(read32(H_CONTROL));
+}
+
+int ProjectFile::scriptCount() const
+{
+    return read32(H_SCRIPT_COUNT);
+}
+
+QString ProjectFile::scriptName(int idx) const
+{
+    return string(read32(read32(H_SCRIPTS) + qint64(idx)*SCRIPT_SIZE));
+}
+
+QString ProjectFile::scriptText(int idx) const
+{
+    return string(read32(read32(H_SCRIPTS) + qint64(idx)*SCRIPT_SIZE + 4));
+}
+
+int ProjectFile::fileCount() const
+{
+    return read32(H_FILE_COUNT);
+}
+
+QString ProjectFile::fileFolder(int idx) const
+{
+    return string(read32(read32(H_FILES) + qint64(idx)*FILE_SIZE + F_FOLDER));
+}
+
+QString ProjectFile::fileSource(int idx) const
+{
+    return string(read32(read32(H_FILES) + qint64(idx)*FILE_SIZE + F_SOURCE));
+}
+
+quint32 ProjectFile::fileMode(int idx) const
+{
+    return read32(read32(H_FILES) + qint64(idx)*FILE_SIZE + F_MODE);
+}
+
+FileSignatureInfo ProjectFile::fileSignature(int idx) const
+{
+    const qint64 record = read32(H_FILES) + qint64(idx)*FILE_SIZE;
+    quint32 category = read32(record + F_CATEGORY);
+    if (category > FileSignatureInfo::INEXISTANT)
+        category = FileSignatureInfo::UNKNOW;
+    FileSignatureInfo ret(bytes(read32(record + F_SOURCE)).toStdString(),
+                          bytes(read32(record + F_SIGNATURE)).toStdString(),
+                          FileSignatureInfo::Category(category),
+                          read64(record + F_SIZE));
+    const quint32 content = read32(record + F_CONTENT);
+    if (content > 0)
+        ret.setContent(bytes(content-1).toStdString());
+    return ret;
+}
+
+quint32 ProjectFile::read32(qint64 offset) const
+{
+    return (data && offset >= 0 && offset+4 <= size) ? qFromLittleEndian<quint32>(data+offset) : 0;
+}
+
+quint64 ProjectFile::read64(qint64 offset) const
+{
+    return (data && offset >= 0 && offset+8 <= size) ? qFromLittleEndian<quint64>(data+offset) : 0;
+}
+
+QString ProjectFile::string(quint32 id) const
+{
+    const QByteArray utf8 = bytes(id);
+    return QString::fromUtf8(utf8.constData(), utf8.size());
+}
+
+QByteArray ProjectFile::bytes(quint32 id) const
+{
+    // no copy, the bytes are read in the mapping
+    QByteArray ret;
+    if (id < read32(H_STRING_COUNT)){
+        const qint64 entry = read32(H_STRINGS) + qint64(id)*STRING_SIZE;
+        const qint64 offset = qint64(read32(H_BLOB)) + read32(entry);
+        const qint64 length = read32(entry+4);
+        if (offset + length <= size)
+            ret = QByteArray::fromRawData(reinterpret_cast<const char*>(data+offset), length);
+    }
+    return ret;
+}
@@ -0,0 +1,55 @@
+#ifndef PROJECTFILE_H
+#define PROJECTFILE_H
+
+#include <QFile>
+#include <QPair>
+#include <QString>
+#include <QVector>
+#include "filesignatureinfo.hpp"
+
+class RealFile;
+
+/**
+ * @brief The ProjectFile class
+ * Binary project format, a header, a table of the distinct strings
+ * and fixed size records for the scripts and the files. The file is
+ * mapped and a string is only decoded when it is asked, the cached
+ * signatures avoid to read the files of the package again.
+ */
+
+class ProjectFile
+{
+
+public:
+    static const quint32 formatVersion;
+    static bool isProjectFile(const QString& fileName);
+    static bool write(const QString& fileName, const QString& package, const QString& version, const QString& control,
+                      const QVector<QPair<QString, QString> >& scripts, const QVector<RealFile *>& files);
+
+    ProjectFile(const QString& fileName);
+    ~ProjectFile();
+    bool open();
+    QString getPackage() const;
+    QString getVersion() const;
+    QString getControl() const;
+    int scriptCount() const;
+    QString scriptName(int idx) const;
+    QString scriptText(int idx) const;
+    int fileCount() const;
+    QString fileFolder(int idx) const;
+    QString fileSource(int idx) const;
+    quint32 fileMode(int idx) const;
+    FileSignatureInfo fileSignature(int idx) const;
+
+private:
+    quint32 read32(qint64 offset) const;
+    quint64 read64(qint64 offset) const;
+    QString string(quint32 id) const;
+    QByteArray bytes(quint32 id) const;
+    QFile file;
+    const uchar *data;
+    qint64 size;
+
+};
+
+#endif // PROJECTFILE_H
@@ -0,0 +1,148 @@
+#include "projectrestorer.h"
+#include "treepackagedragdropmodel.h"
+#include "nodearena.h"
+#include "folder.h"
+#include "realfile.h"
+#include <QFileInfo>
+#include <QRunnable>
+#include <QThreadPool>
+
+namespace {
+// entries checked by a task of the pool
+const int CHUNK_SIZE = 256;
+
+class ValidateTask : public QRunnable
+{
+public:
+    ValidateTask(RestoreEntry *first, RestoreEntry *last)
+        : first(first), last(last)
+    {
+
+    }
+
+    void run()
+    {
+        // a cached signature only needs the file to still exist
+        for (RestoreEntry *entry = first; entry != last; entry++){
+            if (entry->cached){
+                // the stored copy replaces a moved source
+                const bool found = (!entry->stored.isEmpty() && QFileInfo::exists(entry->stored)) || QFileInfo::exists(entry->source);
+                if (!found)
+                    entry->info = FileSignatureInfo();
+            } else {
+                entry->info.set_file(entry->source.toStdString());
+            }
+        }
+    }
+
+private:
+    RestoreEntry *first;
+    RestoreEntry *last;
+};
+}
+
+ProjectRestorer::ProjectRestorer(const QVector<RestoreEntry> &entries, const QString &packageName, QObject *parent)
+    : QThread(parent)
+{
+    this->entries = entries;
+    this->packageName = packageName;
+    arena = Q_NULLPTR;
+    root = Q_NULLPTR;
+}
+
+ProjectRestorer::~ProjectRestorer()
+{
+    requestInterruption();
+    wait();
+    // not adopted by the model
+    delete arena;
+}
+
+NodeArena *ProjectRestorer::takeArena()
+{
+    NodeArena *ret = arena;
+    arena = Q_NULLPTR;
+    return ret;
+}
+
+Folder *ProjectRestorer::getRoot()
+{
+    return root;
+}
+
+QVector<RealFile *> ProjectRestorer::getFiles()
+{
+    return files;
+}
+
+QSet<quint64> ProjectRestorer::getPackageFolders()
+{
+    return packageFolders;
+}
+
+QStringList ProjectRestorer::getMissing()
+{
+    return missing;
+}
+
+void ProjectRestorer::run()
+{
+    validate();
+    if (!isInterruptionRequested())
+        build();
+}
+
+void ProjectRestorer::validate()
+{
+    // the entries are not resized, the tasks can write in place
+    QThreadPool pool;
+    pool.setMaxThreadCount(QThread::idealThreadCount());
+    RestoreEntry *data = entries.data();
+    for (int i=0; i<entries.size(); i+=CHUNK_SIZE){
+        ValidateTask *task = new ValidateTask(data+i, data+qMin(i+CHUNK_SIZE, entries.size()));
+        pool.start(task);
+    }
+    pool.waitForDone();
+}
+
+void ProjectRestorer::build()
+{
+    arena = new NodeArena();
+    root = TreePackageDragDropModel::createSkeleton(arena, packageName.toStdString());
+    for (int i=0; i<entries.size() && !isInterruptionRequested(); i++){
+        RestoreEntry &entry = entries[i];
+        if (entry.info.getCategory() == FileSignatureInfo::INEXISTANT){
+            missing.append(entry.source);
+        } else {
+            Folder *f = ensureFolder(entry.folder);
+            FileSignatureInfo *fsi = arena->createFileSignatureInfo(entry.info);
+            RealFile *rf = arena->createFile(QFileInfo(entry.source).completeBaseName().toStdString(), false, fsi);
+            rf->setMode(entry.mode);
+            f->add(rf);
+            files.append(rf);
+        }
+    }
+}
+
+Folder *ProjectRestorer::ensureFolder(const QString &path)
+{
+    Folder *ret = root->findFolder(path.toStdString());
+    if (!ret){
+        QStringList sl = path.split("/");
+        sl.removeAll(QString());
+        ret = root;
+        for (int idx=0; idx<sl.size(); idx++){
+            if (Folder *current = ret->getChild<Folder*>(sl.at(idx).toStdString())){
+                ret = current;
+            } else {
+                const bool packageFolder = TreePackageDragDropModel::isPackageFolder(sl, idx, packageName);
+                Folder *nf = arena->createFolder(sl.at(idx).toStdString(), packageFolder);
+                if (packageFolder)
+                    packageFolders.insert(nf->getId());
+                ret->add(nf);
+                ret = nf;
+            }
+        }
+    }
+    return ret;
+}
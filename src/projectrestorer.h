@@ -0,0 +1,66 @@
+#ifndef PROJECTRESTORER_H
+#define PROJECTRESTORER_H
+
+#include "filesignatureinfo.hpp"
+#include <QThread>
+#include <QSet>
+#include <QStringList>
+#include <QVector>
+
+class NodeArena;
+class Folder;
+class RealFile;
+
+/**
+ * @brief The RestoreEntry struct
+ * A file of a project, its signature is read again unless cached
+ * The stored copy, if any, is checked instead of the source
+ */
+
+struct RestoreEntry
+{
+    QString folder;
+    QString source;
+    QString stored;
+    // the saved permissions, 0 if unknown
+    quint32 mode;
+    bool cached;
+    FileSignatureInfo info;
+};
+
+/**
+ * @brief The ProjectRestorer class
+ * Check the files of a project in parallel and build the package tree
+ * in its own NodeArena, the model adopts the whole tree once finished.
+ */
+
+class ProjectRestorer : public QThread
+{
+    Q_OBJECT
+public:
+    ProjectRestorer(const QVector<RestoreEntry>& entries, const QString& packageName, QObject *parent = Q_NULLPTR);
+    ~ProjectRestorer();
+    NodeArena *takeArena();
+    Folder *getRoot();
+    QVector<RealFile *> getFiles();
+    QSet<quint64> getPackageFolders();
+    QStringList getMissing();
+
+protected:
+    virtual void run();
+
+private:
+    void validate();
+    void build();
+    Folder *ensureFolder(const QString& path);
+    QVector<RestoreEntry> entries;
+    QString packageName;
+    NodeArena *arena;
+    Folder *root;
+    QVector<RealFile *> files;
+    QSet<quint64> packageFolders;
+    QStringList missing;
+
+};
+
+#endif // PROJECTRESTORER_H
@@ -2,11 +2,14 @@
 #include "filesignatureinfo.hpp"
 
 RealFile::RealFile(const std::string &name, bool canRename, FileSignatureInfo *fsi)
-    : AbstractFile(name, canRename)
+    : AbstractFile(name, REALFILE, canRename)
 {
     this->fsi = fsi;
+    this->mode = 0;
     if (this->fsi == nullptr){
-        this->fsi = new FileSignatureInfo("inexistantfile");
+        // all the files created by debpac share the same info
+        static FileSignatureInfo inexistant("inexistantfile");
+        this->fsi = &inexistant;
         fromFileSystem = false;
     } else {
         fromFileSystem = true;
@@ -15,10 +18,30 @@ RealFile::RealFile(const std::string &name, bool canRename, FileSignatureInfo *f
 
 RealFile::~RealFile()
 {
-    delete fsi;
+    // the FileSignatureInfo is owned and released by the NodeArena
 }
 
 FileSignatureInfo &RealFile::getFileSignatureInfo()
 {
     return (*fsi);
 }
+
+bool RealFile::isFromFileSystem()
+{
+    return fromFileSystem;
+}
+
+long long RealFile::getSize()
+{
+    return fsi->getSize();
+}
+
+unsigned int RealFile::getMode() const
+{
+    return mode;
+}
+
+void RealFile::setMode(unsigned int mode)
+{
+    this->mode = mode;
+}
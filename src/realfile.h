@@ -16,10 +16,16 @@ public:
     RealFile(const std::string& name, bool canRename, FileSignatureInfo *fsi = nullptr);
     ~RealFile();
     FileSignatureInfo& getFileSignatureInfo();
+    bool isFromFileSystem();
+    long long getSize();
+    unsigned int getMode() const;
+    void setMode(unsigned int mode);
 
 private:
     bool fromFileSystem;
     FileSignatureInfo *fsi;
+    // the permissions saved with the project, 0 to take the ones of the source
+    unsigned int mode;
 };
 
 #endif // REALFILE_H
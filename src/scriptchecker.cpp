@@ -0,0 +1,102 @@
+#include "scriptchecker.h"
+#include <QCryptographicHash>
+#include <QRegularExpression>
+
+namespace {
+// shells run at once
+const int MAX_PROCESSES = 2;
+// a check taking longer is killed
+const int CHECK_TIMEOUT = 5000;
+// texts whose result is kept
+const int MAX_RESULTS = 256;
+}
+
+ScriptChecker::ScriptChecker(QObject *parent)
+    : QObject(parent), results(MAX_RESULTS)
+{
+    scheduler = new JobScheduler(MAX_PROCESSES, this);
+    connect(scheduler, SIGNAL(jobFinished(JobScheduler::Result)), this, SLOT(jobFinished(JobScheduler::Result)));
+}
+
+ScriptChecker::~ScriptChecker()
+{
+    // the running processes are killed with the JobScheduler
+}
+
+void ScriptChecker::check(const QString &name, const QString &text)
+{
+    const QByteArray hash = QCryptographicHash::hash(text.toUtf8(), QCryptographicHash::Sha1);
+    latest.insert(name, hash);
+    if (QVector<Error> *errors = results.object(hash)){
+        emit checked(name, *errors);
+    } else {
+        // the older texts of the script are not checked, or not shown
+        bool isChecked = false;
+        for (int id : checks.keys()){
+            if (checks.value(id).hash == hash)
+                isChecked = true;
+            else if (checks.value(id).name == name)
+                scheduler->cancel(id);
+        }
+        if (!isChecked){
+            JobScheduler::Job job;
+            // the script is read on the standard input, nothing is written on the disk
+            job.program = interpreter(text);
+            job.arguments << "-n";
+            job.input = text.toUtf8();
+            job.timeout = CHECK_TIMEOUT;
+            job.priority = JobScheduler::LOW;
+            Check check;
+            check.name = name;
+            check.hash = hash;
+            checks.insert(scheduler->submit(job), check);
+        }
+    }
+}
+
+void ScriptChecker::jobFinished(const JobScheduler::Result &result)
+{
+    const Check check = checks.take(result.id);
+    // not kept when the shell is missing, killed or cancelled
+    if (result.started && !result.timedOut && !result.canceled && result.exitStatus == QProcess::NormalExit){
+        const QString output = QString::fromLocal8Bit(result.errors);
+        QVector<Error> errors = parseErrors(output);
+        if (result.exitCode != 0 && errors.isEmpty()){
+            Error error;
+            error.line = 0;
+            error.message = output.trimmed().isEmpty() ? QString("The shell exited with code %1").arg(result.exitCode) : output.trimmed();
+            errors.append(error);
+        }
+        results.insert(check.hash, new QVector<Error>(errors));
+        if (latest.value(check.name) == check.hash)
+            emit checked(check.name, errors);
+    }
+}
+
+QString ScriptChecker::interpreter(const QString &text)
+{
+    const QString shebang = text.startsWith("#!") ? text.left(text.indexOf('\n')) : QString();
+    return shebang.contains("bash") ? "bash" : "sh";
+}
+
+QVector<ScriptChecker::Error> ScriptChecker::parseErrors(const QString &output)
+{
+    // dash: "sh: 3: Syntax error: ...", bash: "bash: line 3: syntax error ..."
+    static const QRegularExpression regex("^[^:]*: (?:line )?(\\d+): (.*)$", QRegularExpression::MultilineOption);
+    QVector<Error> ret;
+    QRegularExpressionMatchIterator it = regex.globalMatch(output);
+    while (it.hasNext()){
+        const QRegularExpressionMatch match = it.next();
+        const int line = match.captured(1).toInt();
+        if (!ret.isEmpty() && ret.last().line == line){
+            // bash gives the text of the line after the error
+            ret.last().message.append("\n"+match.captured(2));
+        } else {
+            Error error;
+            error.line = line;
+            error.message = match.captured(2);
+            ret.append(error);
+        }
+    }
+    return ret;
+}
@@ -0,0 +1,55 @@
+#ifndef SCRIPTCHECKER_H
+#define SCRIPTCHECKER_H
+
+#include "jobscheduler.h"
+#include <QObject>
+#include <QCache>
+#include <QHash>
+#include <QVector>
+
+/**
+ * @brief The ScriptChecker class
+ * Check the syntax of the maintainer scripts with sh -n (bash -n for a
+ * bash shebang) in a few background processes of a JobScheduler. The
+ * results are kept by content, a text already checked is answered at once.
+ */
+
+class ScriptChecker : public QObject
+{
+    Q_OBJECT
+public:
+    struct Error
+    {
+        // from 1, 0 when the shell gave no line
+        int line;
+        QString message;
+    };
+    ScriptChecker(QObject *parent = Q_NULLPTR);
+    ~ScriptChecker();
+    void check(const QString& name, const QString& text);
+
+signals:
+    // only for the last text given for the script
+    void checked(const QString &name, const QVector<ScriptChecker::Error> &errors);
+
+private slots:
+    void jobFinished(const JobScheduler::Result &result);
+
+private:
+    struct Check
+    {
+        QString name;
+        QByteArray hash;
+    };
+    static QString interpreter(const QString& text);
+    static QVector<Error> parseErrors(const QString& output);
+    JobScheduler *scheduler;
+    QCache<QByteArray, QVector<Error> > results;
+    // by job id, waiting or running
+    QHash<int, Check> checks;
+    // hash of the last text of each script
+    QHash<QString, QByteArray> latest;
+
+};
+
+#endif // SCRIPTCHECKER_H
@@ -4,15 +4,31 @@
 #include "syntaxhighlighter.h"
 #include <QTextStream>
 #include <QTabBar>
+#include <QTextCursor>
+#include <QTextDocument>
+#include <QTextBlock>
+#include <QTimer>
+
+namespace {
+// time without typing before the scripts are checked
+const int CHECK_DELAY = 500;
+}
 
 ScripEditorTabWidget::ScripEditorTabWidget(QWidget *parent)
     : QTabWidget(parent)
 {
+    checker = new ScriptChecker(this);
+    connect(checker, SIGNAL(checked(QString,QVector<ScriptChecker::Error>)), this, SLOT(showScriptErrors(QString,QVector<ScriptChecker::Error>)));
+    checkTimer = new QTimer(this);
+    checkTimer->setSingleShot(true);
+    checkTimer->setInterval(CHECK_DELAY);
+    connect(checkTimer, SIGNAL(timeout()), this, SLOT(checkScripts()));
     QFile file("://file/control");
     if (file.open(QFile::ReadOnly | QFile::Text)){
         QTextStream stream(&file);
         controlFile = new ControlFileEditor(this);
         controlFile->setPlainText(stream.readAll());
+        watch(controlFile);
         QTabWidget::addTab(controlFile, "control");
     } else {
         controlFile = Q_NULLPTR;
@@ -58,6 +74,7 @@ int ScripEditorTabWidget::addScriptEdit(const QString &label)
             CodeEditor *ce = new CodeEditor(this);
             ce->setSyntaxHighlighter(new SyntaxHighLighter(SyntaxHighLighter::SCRIPT, ce->document()));
             ce->setPlainText(stream.readAll());
+            watch(ce);
             scriptTab.append(ce);
             ret = QTabWidget::addTab(ce, label);
         }
@@ -96,6 +113,7 @@ int ScripEditorTabWidget::addDesktopEdit()
                                 "/usr/bin/"+controlFile->getPackageName()
                                 )
                             );
+                watch(ce);
                 scriptTab.append(ce);
                 ret = QTabWidget::addTab(ce, label);
             }
@@ -150,3 +168,66 @@ QVector<CodeEditor *> ScripEditorTabWidget::getScriptTabs()
 {
     return scriptTab;
 }
+
+void ScripEditorTabWidget::applyTextEdit(const QString &tab, int position, int removed, const QString &text)
+{
+    // done with the cursor of the editor, it reacts as if typed
+    if (CodeEditor *ce = qobject_cast<CodeEditor*>(widget(getIndexByName(tab)))){
+        const int end = ce->document()->characterCount()-1;
+        const int from = qBound(0, position, end);
+        QTextCursor cursor(ce->document());
+        cursor.setPosition(from);
+        cursor.setPosition(from+qBound(0, removed, end-from), QTextCursor::KeepAnchor);
+        ce->setTextCursor(cursor);
+        ce->insertPlainText(text);
+    }
+}
+
+void ScripEditorTabWidget::documentChanged(int position, int removed, int added)
+{
+    QTextDocument *document = qobject_cast<QTextDocument*>(sender());
+    for (int i=0; i<count(); i++){
+        CodeEditor *ce = qobject_cast<CodeEditor*>(widget(i));
+        if (ce && ce->document() == document){
+            // only the inserted characters are sent, not the whole text
+            QTextCursor cursor(document);
+            cursor.setPosition(qMin(position, document->characterCount()-1));
+            cursor.setPosition(qMin(position+added, document->characterCount()-1), QTextCursor::KeepAnchor);
+            emit textEdited(tabText(i), position, removed, cursor.selectedText().replace(QChar::ParagraphSeparator, '\n'));
+        }
+    }
+    checkTimer->start();
+}
+
+void ScripEditorTabWidget::checkScripts()
+{
+    // an unchanged script is answered from the results of the checker
+    for (CodeEditor *ce : scriptTab){
+        const int tab = indexOf(ce);
+        if (tab != -1 && !tabText(tab).endsWith(".desktop"))
+            checker->check(tabText(tab), ce->toPlainText());
+    }
+}
+
+void ScripEditorTabWidget::showScriptErrors(const QString &tabname, const QVector<ScriptChecker::Error> &errors)
+{
+    if (CodeEditor *ce = qobject_cast<CodeEditor*>(widget(getIndexByName(tabname)))){
+        // the whole line is underlined, the shell gives no column
+        QVector<CodeEditor::Diagnostic> diagnostics;
+        for (const ScriptChecker::Error &error : errors){
+            // "end of file unexpected" can be after the last line
+            const QTextBlock block = error.line > 0 ? ce->document()->findBlockByNumber(qMin(error.line, ce->document()->blockCount())-1) : QTextBlock();
+            CodeEditor::Diagnostic diagnostic;
+            diagnostic.position = block.isValid() ? block.position() : 0;
+            diagnostic.length = block.isValid() ? block.length()-1 : 0;
+            diagnostic.message = error.message;
+            diagnostics.append(diagnostic);
+        }
+        ce->setDiagnostics(diagnostics);
+    }
+}
+
+void ScripEditorTabWidget::watch(CodeEditor *editor)
+{
+    connect(editor->document(), SIGNAL(contentsChange(int,int,int)), this, SLOT(documentChanged(int,int,int)));
+}
@@ -1,17 +1,20 @@
 #ifndef TABWIDGET_H
 #define TABWIDGET_H
 
+#include "scriptchecker.h"
 #include <QTabWidget>
 #include <QVector>
 
 class QPlainTextEdit;
 class CodeEditor;
 class ControlFileEditor;
+class QTimer;
 
 /**
  * @brief The ScripEditorTabWidget class
  * The TabWidget for the debian files edition:
- * post/pre-inst/rm, .desktop and control file
+ * post/pre-inst/rm, .desktop and control file.
+ * The scripts are checked by the ScriptChecker once the typing pauses.
  */
 
 class ScripEditorTabWidget : public QTabWidget
@@ -24,9 +27,11 @@ public:
     ControlFileEditor *getControlFile();
     QVector<CodeEditor *> getScriptTabs();
     int getIndexByName(const QString& name);
+    void applyTextEdit(const QString& tab, int position, int removed, const QString& text);
 
 signals:
     void removeScriptTab(const QString &tabname);
+    void textEdited(const QString &tabname, int position, int removed, const QString &text);
 
 public slots:
     void closeScriptTab(int tab);
@@ -36,9 +41,17 @@ public slots:
     int addDesktopEdit(const QIcon &icon);
     void renameDesktopTab(const QString &oldname, const QString &newname);
 
+private slots:
+    void documentChanged(int position, int removed, int added);
+    void checkScripts();
+    void showScriptErrors(const QString &tabname, const QVector<ScriptChecker::Error> &errors);
+
 private:
+    void watch(CodeEditor *editor);
     ControlFileEditor *controlFile;
     QVector<CodeEditor*> scriptTab;
+    ScriptChecker *checker;
+    QTimer *checkTimer;
 
 };
 
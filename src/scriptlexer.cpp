@@ -0,0 +1,44 @@
+#include "scriptlexer.h"
+
+namespace {
+// lines sent at once
+const int BATCH_SIZE = 4096;
+}
+
+ScriptLexer::ScriptLexer(int job, const QString &text, QObject *parent)
+    : QThread(parent)
+{
+    this->job = job;
+    this->text = text;
+}
+
+ScriptLexer::~ScriptLexer()
+{
+    requestInterruption();
+    wait();
+}
+
+void ScriptLexer::run()
+{
+    // one line per block of the document
+    QVector<int> states;
+    QVector<QVector<ShellLexer::Token> > tokens;
+    int state = ShellLexer::INITIAL;
+    int pos = 0;
+    bool done = false;
+    while (!done && !isInterruptionRequested()){
+        int end = text.indexOf('\n', pos);
+        done = end == -1;
+        if (done)
+            end = text.size();
+        tokens.append(QVector<ShellLexer::Token>());
+        state = ShellLexer::lexLine(text.mid(pos, end-pos), state, tokens.last());
+        states.append(state);
+        pos = end+1;
+        if (done || states.size() == BATCH_SIZE){
+            emit linesLexed(job, states, tokens);
+            states.clear();
+            tokens.clear();
+        }
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef SCRIPTLEXER_H
+#define SCRIPTLEXER_H
+
+#include "shelllexer.h"
+#include <QThread>
+#include <QMetaType>
+
+Q_DECLARE_METATYPE(ShellLexer::Token)
+
+/**
+ * @brief The ScriptLexer class
+ * Lex a copy of a whole script in background for the SyntaxHighLighter,
+ * the tokens and the state of the lines are sent by batches in order.
+ */
+
+class ScriptLexer : public QThread
+{
+    Q_OBJECT
+public:
+    ScriptLexer(int job, const QString& text, QObject *parent = Q_NULLPTR);
+    ~ScriptLexer();
+
+signals:
+    void linesLexed(int job, const QVector<int> &states, const QVector<QVector<ShellLexer::Token> > &tokens);
+
+protected:
+    virtual void run();
+
+private:
+    int job;
+    QString text;
+
+};
+
+#endif // SCRIPTLEXER_H
@@ -0,0 +1,296 @@
+#include "searchindex.h"
+#include "folder.h"
+#include <algorithm>
+#include <cctype>
+#include <unordered_set>
+
+namespace {
+// a name padded with this marker gives the grams of its first characters
+const char START = '\x01';
+// shorter terms are only matched exactly
+const std::size_t TYPO_LENGTH = 4;
+
+bool containsNoCase(const std::string& text, const std::string& lowerTerm)
+{
+    auto it = std::search(text.begin(), text.end(), lowerTerm.begin(), lowerTerm.end(),
+                          [](char c, char t) { return std::tolower(static_cast<unsigned char>(c)) == t; });
+    return it != text.end();
+}
+
+bool startsWithNoCase(const std::string& text, const std::string& lowerTerm)
+{
+    return text.size() >= lowerTerm.size() && containsNoCase(text.substr(0, lowerTerm.size()), lowerTerm);
+}
+
+bool containsWithTypo(const std::string& text, const std::string& lowerTerm)
+{
+    // edit distance between the term and the closest part of the text,
+    // one column of the matrix per character of the text
+    std::vector<std::size_t> column(lowerTerm.size()+1);
+    for (std::size_t i=0; i<column.size(); i++)
+        column[i] = i;
+    bool ret = column.back() <= 1;
+    for (std::size_t j=0; j<text.size() && !ret; j++){
+        const char c = std::tolower(static_cast<unsigned char>(text[j]));
+        // the match can start anywhere, the first row stays 0
+        std::size_t diagonal = 0;
+        for (std::size_t i=1; i<column.size(); i++){
+            const std::size_t up = column[i];
+            column[i] = std::min(std::min(up, column[i-1])+1, diagonal + (lowerTerm[i-1] != c ? 1 : 0));
+            diagonal = up;
+        }
+        ret = column.back() <= 1;
+    }
+    return ret;
+}
+}
+
+SearchIndex::SearchIndex(NodeArena *arena)
+    : arena(arena), indexed(0), stale(0)
+{
+
+}
+
+void SearchIndex::insert(AbstractFile *af)
+{
+    const NodeArena::Handle h = arena->handle(af);
+    for (Gram g : grams(lower(af->getName()), true)){
+        // the lists are sorted to be intersected, a new node
+        // almost always has the highest handle
+        std::vector<NodeArena::Handle> &list = postings[g];
+        if (list.empty() || list.back() < h){
+            list.push_back(h);
+        } else {
+            auto it = std::lower_bound(list.begin(), list.end(), h);
+            if (*it != h)
+                list.insert(it, h);
+        }
+    }
+    indexed++;
+    if (stale > 1024 && stale*2 > indexed)
+        compact();
+}
+
+void SearchIndex::rename(AbstractFile *af)
+{
+    // the grams of the old name stay until the next compaction
+    stale++;
+    insert(af);
+}
+
+void SearchIndex::remove(AbstractFile *af)
+{
+    // the handles of the destroyed nodes no longer resolve,
+    // they are only counted to know when to compact
+    Folder *f = af->toFolder();
+    stale += f ? f->count(true)+1 : 1;
+}
+
+void SearchIndex::clear()
+{
+    postings.clear();
+    indexed = 0;
+    stale = 0;
+}
+
+std::vector<AbstractFile *> SearchIndex::find(const std::string &query, Folder *root, std::size_t max) const
+{
+    std::vector<AbstractFile *> ret;
+    const std::vector<Term> parsed = terms(lower(query));
+    // the shortest posting list gives the candidates, they are looked up
+    // in the other lists from the shortest, the first miss rejects them
+    static const std::vector<NodeArena::Handle> none;
+    std::vector<const std::vector<NodeArena::Handle> *> lists;
+    for (const Term &t : parsed){
+        for (Gram g : grams(t.name, t.name.size() < 3)){
+            auto it = postings.find(g);
+            lists.push_back(it != postings.end() ? &it->second : &none);
+        }
+    }
+    std::sort(lists.begin(), lists.end(),
+              [](const std::vector<NodeArena::Handle> *a, const std::vector<NodeArena::Handle> *b) { return a->size() < b->size(); });
+    lists.erase(std::unique(lists.begin(), lists.end()), lists.end());
+    if (!lists.empty()){
+        const std::vector<NodeArena::Handle> &candidates = *lists.front();
+        for (std::size_t i=0; i<candidates.size() && ret.size() < max; i++){
+            const NodeArena::Handle h = candidates[i];
+            bool match = true;
+            for (std::size_t l=1; l<lists.size() && match; l++){
+                match = std::binary_search(lists.at(l)->begin(), lists.at(l)->end(), h);
+            }
+            AbstractFile *af = match ? arena->resolve(h) : nullptr;
+            match = af && af != root;
+            for (std::size_t j=0; j<parsed.size() && match; j++){
+                match = matches(af, root, parsed.at(j), false);
+            }
+            if (match)
+                ret.push_back(af);
+        }
+    }
+    if (ret.size() < max)
+        findApproximate(parsed, root, max, ret);
+    return ret;
+}
+
+void SearchIndex::findApproximate(const std::vector<Term> &terms, Folder *root, std::size_t max, std::vector<AbstractFile *> &found) const
+{
+    // the candidates come from the longest term: a typo breaks at most
+    // 3 of its trigrams, the others must be in the name
+    const Term *longest = nullptr;
+    for (const Term &t : terms){
+        if (!longest || t.name.size() > longest->name.size())
+            longest = &t;
+    }
+    if (longest && longest->name.size() >= TYPO_LENGTH){
+        static const std::vector<NodeArena::Handle> none;
+        std::vector<const std::vector<NodeArena::Handle> *> lists;
+        for (Gram g : grams(longest->name, false)){
+            auto it = postings.find(g);
+            lists.push_back(it != postings.end() ? &it->second : &none);
+        }
+        std::sort(lists.begin(), lists.end(),
+                  [](const std::vector<NodeArena::Handle> *a, const std::vector<NodeArena::Handle> *b) { return a->size() < b->size(); });
+        const std::size_t needed = lists.size() > 3 ? lists.size()-3 : 1;
+        // a candidate is in one of the smallest lists at least, they are
+        // merged in the order of the handles (the oldest nodes first, as
+        // the exact matches) until enough names are found
+        const std::size_t seeds = lists.size()-needed+1;
+        std::vector<std::size_t> heads(seeds, 0);
+        const std::unordered_set<AbstractFile*> exact(found.begin(), found.end());
+        bool more = true;
+        while (more && found.size() < max){
+            more = false;
+            NodeArena::Handle h = 0;
+            for (std::size_t l=0; l<seeds; l++){
+                if (heads[l] < lists[l]->size() && (!more || lists[l]->at(heads[l]) < h)){
+                    h = lists[l]->at(heads[l]);
+                    more = true;
+                }
+            }
+            if (more){
+                std::size_t count = 0;
+                for (std::size_t l=0; l<seeds; l++){
+                    if (heads[l] < lists[l]->size() && lists[l]->at(heads[l]) == h){
+                        heads[l]++;
+                        count++;
+                    }
+                }
+                for (std::size_t l=seeds; l<lists.size() && count < needed; l++){
+                    if (std::binary_search(lists[l]->begin(), lists[l]->end(), h))
+                        count++;
+                }
+                AbstractFile *af = count >= needed ? arena->resolve(h) : nullptr;
+                bool match = af && af != root && !exact.count(af);
+                for (std::size_t j=0; j<terms.size() && match; j++){
+                    match = matches(af, root, terms.at(j), terms.at(j).name.size() >= TYPO_LENGTH);
+                }
+                if (match)
+                    found.push_back(af);
+            }
+        }
+    }
+}
+
+std::vector<SearchIndex::Term> SearchIndex::terms(const std::string &query)
+{
+    std::vector<Term> ret;
+    std::string word;
+    for (char c : query + " "){
+        if (c == ' '){
+            Term term;
+            term.text = word;
+            term.folder = !word.empty() && word.back() == '/';
+            // "usr/share/" looks for the share folders under usr
+            std::string trimmed = word;
+            while (!trimmed.empty() && trimmed.back() == '/')
+                trimmed.erase(trimmed.size()-1);
+            const std::size_t slash = trimmed.rfind('/');
+            term.name = trimmed.substr(slash+1);
+            term.folders = slash != std::string::npos ? trimmed.substr(0, slash+1) : std::string();
+            // nothing to look for in a lone "/"
+            if (!term.name.empty())
+                ret.push_back(term);
+            word.clear();
+        } else {
+            word += c;
+        }
+    }
+    return ret;
+}
+
+bool SearchIndex::matches(AbstractFile *af, Folder *root, const Term &term, bool typo)
+{
+    bool ret = !term.folder || af->isFolder();
+    if (ret){
+        if (term.name.size() < 3)
+            ret = startsWithNoCase(af->getName(), term.name);
+        else if (typo)
+            ret = containsWithTypo(af->getName(), term.name);
+        else
+            ret = containsNoCase(af->getName(), term.name);
+    }
+    if (ret && !term.folders.empty()){
+        // with a typo in the name, only its folders are found exactly
+        const std::string path = root->pathOf(af) + "/";
+        ret = containsNoCase(path, typo ? term.folders : term.text);
+    }
+    return ret;
+}
+
+std::string SearchIndex::lower(const std::string &s)
+{
+    std::string ret(s);
+    for (char &c : ret)
+        c = std::tolower(static_cast<unsigned char>(c));
+    return ret;
+}
+
+std::vector<SearchIndex::Gram> SearchIndex::grams(const std::string &name, bool prefix)
+{
+    // prefix: the grams of the start of the name (START + 1 or 2 chars),
+    // otherwise the trigrams inside the name
+    std::vector<Gram> ret;
+    if (prefix && !name.empty()){
+        ret.push_back((1u << 24) | static_cast<unsigned char>(name[0]));
+        if (name.size() >= 2)
+            ret.push_back((Gram(START) << 16) | (Gram(static_cast<unsigned char>(name[0])) << 8) | static_cast<unsigned char>(name[1]));
+    }
+    for (std::size_t i=0; i+3<=name.size(); i++){
+        ret.push_back((Gram(static_cast<unsigned char>(name[i])) << 16)
+                      | (Gram(static_cast<unsigned char>(name[i+1])) << 8)
+                      | static_cast<unsigned char>(name[i+2]));
+    }
+    std::sort(ret.begin(), ret.end());
+    ret.erase(std::unique(ret.begin(), ret.end()), ret.end());
+    return ret;
+}
+
+void SearchIndex::compact()
+{
+    // keep the handles still alive and whose current name has the gram
+    std::unordered_map<AbstractFile*, std::vector<Gram> > current;
+    for (auto it = postings.begin(); it != postings.end(); ){
+        std::vector<NodeArena::Handle> &list = it->second;
+        std::vector<NodeArena::Handle> kept;
+        for (NodeArena::Handle h : list){
+            AbstractFile *af = arena->resolve(h);
+            if (af){
+                auto itc = current.find(af);
+                if (itc == current.end())
+                    itc = current.emplace(af, grams(lower(af->getName()), true)).first;
+                if (std::binary_search(itc->second.begin(), itc->second.end(), it->first))
+                    kept.push_back(h);
+            }
+        }
+        std::sort(kept.begin(), kept.end());
+        kept.erase(std::unique(kept.begin(), kept.end()), kept.end());
+        if (kept.empty()){
+            it = postings.erase(it);
+        } else {
+            list.swap(kept);
+            it++;
+        }
+    }
+    indexed = current.size();
+    stale = 0;
+}
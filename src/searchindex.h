@@ -0,0 +1,59 @@
+#ifndef SEARCHINDEX_H
+#define SEARCHINDEX_H
+
+#include "nodearena.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+class AbstractFile;
+class Folder;
+
+/**
+ * @brief The SearchIndex class
+ * Trigram index of the node names of a package tree, the posting
+ * lists hold arena handles so removed nodes are dropped when resolved.
+ * A query is made of terms separated by spaces, all of them must be
+ * found (case insensitive) in the name, or in the path for the terms
+ * containing a '/'. Terms shorter than 3 characters match the start
+ * of the name, a term ending with '/' matches the folders.
+ * When the exact matches are not enough, the terms of 4 characters or
+ * more are matched again with one typo (an edit distance of 1).
+ */
+
+class SearchIndex
+{
+
+public:
+    SearchIndex(NodeArena *arena);
+    void insert(AbstractFile *af);
+    void rename(AbstractFile *af);
+    void remove(AbstractFile *af);
+    void clear();
+    std::vector<AbstractFile *> find(const std::string& query, Folder *root, std::size_t max) const;
+
+private:
+    typedef std::uint32_t Gram;
+    struct Term
+    {
+        std::string text;
+        // after the last '/', and the folders before it
+        std::string name;
+        std::string folders;
+        bool folder;
+    };
+    static std::string lower(const std::string& s);
+    static std::vector<Gram> grams(const std::string& name, bool prefix);
+    static std::vector<Term> terms(const std::string& query);
+    static bool matches(AbstractFile *af, Folder *root, const Term& term, bool typo);
+    void findApproximate(const std::vector<Term>& terms, Folder *root, std::size_t max, std::vector<AbstractFile *>& found) const;
+    void compact();
+    NodeArena *arena;
+    std::unordered_map<Gram, std::vector<NodeArena::Handle> > postings;
+    // indexed names, and the ones no longer valid (renamed or removed)
+    std::size_t indexed;
+    std::size_t stale;
+
+};
+
+#endif // SEARCHINDEX_H
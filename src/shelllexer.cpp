@@ -0,0 +1,329 @@
+#include "shelllexer.h"
+#include <QHash>
+#include <QMutex>
+#include <QStringList>
+
+namespace {
+// what is open at the end of a line
+enum Mode { NORMAL=0, SINGLE_QUOTED, DOUBLE_QUOTED, HEREDOC_BODY, HEREDOC_TABS };
+// state of a line: mode, flags, case depth, delimiter of the here-document
+const int MODE_MASK = 0x7;
+const int CONTINUATION = 0x8;
+const int EXPECT_PATTERN = 0x10;
+const int CASE_SHIFT = 5;
+const int CASE_MASK = 0xf << CASE_SHIFT;
+const int MAX_CASE_DEPTH = 15;
+const int DELIMITER_SHIFT = 9;
+
+// the lines can be lexed by several threads, the delimiters are shared
+QMutex delimitersMutex;
+QStringList delimiters;
+QHash<QString, int> delimiterIds;
+
+bool isMeta(QChar c)
+{
+    bool ret = false;
+    switch (c.unicode()) {
+    case ';': case '|': case '&': case '(': case ')': case '<': case '>':
+    case '`': case '"': case '\'': case '$': case '\\':
+        ret = true;
+        break;
+    default:
+        break;
+    }
+    return ret;
+}
+
+bool isAssignment(const QString &word)
+{
+    // NAME=value before a command
+    const int equal = word.indexOf('=');
+    bool ret = equal > 0 && (word.at(0).isLetter() || word.at(0) == '_');
+    for (int i=1; i<equal && ret; i++){
+        ret = word.at(i).isLetterOrNumber() || word.at(i) == '_';
+    }
+    return ret;
+}
+
+void addToken(QVector<ShellLexer::Token> &tokens, int start, int length, ShellLexer::TokenType type)
+{
+    ShellLexer::Token token;
+    token.start = start;
+    token.length = length;
+    token.type = type;
+    tokens.append(token);
+}
+}
+
+int ShellLexer::lexLine(const QString &text, int state, QVector<ShellLexer::Token> &tokens)
+{
+    const int n = text.size();
+    int mode = state & MODE_MASK;
+    int caseDepth = (state & CASE_MASK) >> CASE_SHIFT;
+    int heredoc = state >> DELIMITER_SHIFT;
+    bool expectPattern = state & EXPECT_PATTERN;
+    // a continued line goes on with the arguments of the command
+    bool commandPosition = !(state & CONTINUATION);
+    bool continuation = false;
+    bool caseHeader = false;
+    bool forHeader = false;
+    // here-document started on this line, its body begins on the next one
+    int pending = 0;
+    bool pendingTabs = false;
+    int pos = 0;
+    tokens.clear();
+
+    if (mode == HEREDOC_BODY || mode == HEREDOC_TABS){
+        // the body ends with a line holding only the delimiter
+        addToken(tokens, 0, n, HEREDOC);
+        int first = 0;
+        while (mode == HEREDOC_TABS && first < n && text.at(first) == '\t'){
+            first++;
+        }
+        if (text.midRef(first) == delimiter(heredoc)){
+            mode = NORMAL;
+            heredoc = 0;
+        }
+        pos = n;
+    } else if (mode == SINGLE_QUOTED){
+        const int end = text.indexOf('\'');
+        addToken(tokens, 0, end == -1 ? n : end+1, STRING);
+        if (end != -1){
+            mode = NORMAL;
+            commandPosition = false;
+        }
+        pos = end == -1 ? n : end+1;
+    } else if (mode == DOUBLE_QUOTED){
+        const int at = tokens.size();
+        addToken(tokens, 0, 0, STRING);
+        const int end = skipDoubleQuoted(text, 0, tokens);
+        tokens[at].length = end == -1 ? n : end;
+        if (end != -1){
+            mode = NORMAL;
+            commandPosition = false;
+        }
+        pos = end == -1 ? n : end;
+    }
+
+    while (pos < n){
+        const QChar c = text.at(pos);
+        if (c.isSpace()){
+            pos++;
+        } else if (c == '#'){
+            // only reached at the start of a word
+            addToken(tokens, pos, n-pos, (pos == 0 && text.startsWith("#!")) ? SHEBANG : COMMENT);
+            pos = n;
+        } else if (expectPattern){
+            int end = pos;
+            while (end < n && !text.at(end).isSpace() && !isMeta(text.at(end))){
+                end++;
+            }
+            if (text.midRef(pos, end-pos) == "esac"){
+                addToken(tokens, pos, end-pos, KEYWORD);
+                caseDepth = qMax(0, caseDepth-1);
+                expectPattern = false;
+                commandPosition = false;
+                pos = end;
+            } else {
+                // the pattern goes to the closing parenthesis, quotes included
+                char quote = 0;
+                end = pos;
+                while (end < n && (quote || text.at(end) != ')')){
+                    if (quote && text.at(end) == quote)
+                        quote = 0;
+                    else if (!quote && (text.at(end) == '\'' || text.at(end) == '"'))
+                        quote = text.at(end).toLatin1();
+                    end++;
+                }
+                if (end < n){
+                    end++;
+                    expectPattern = false;
+                    commandPosition = true;
+                }
+                addToken(tokens, pos, end-pos, CASE_PATTERN);
+                pos = end;
+            }
+        } else if (c == '\''){
+            const int end = text.indexOf('\'', pos+1);
+            addToken(tokens, pos, (end == -1 ? n : end+1)-pos, STRING);
+            if (end == -1)
+                mode = SINGLE_QUOTED;
+            pos = end == -1 ? n : end+1;
+            commandPosition = false;
+        } else if (c == '"'){
+            const int at = tokens.size();
+            addToken(tokens, pos, 0, STRING);
+            const int end = skipDoubleQuoted(text, pos+1, tokens);
+            tokens[at].length = (end == -1 ? n : end)-pos;
+            if (end == -1)
+                mode = DOUBLE_QUOTED;
+            pos = end == -1 ? n : end;
+            commandPosition = false;
+        } else if (c == '$'){
+            const int end = skipVariable(text, pos);
+            addToken(tokens, pos, end-pos, VARIABLE);
+            // a command substitution starts a command
+            commandPosition = text.midRef(pos, 2) == "$(";
+            pos = end;
+        } else if (c == '\\'){
+            continuation = pos == n-1;
+            commandPosition = false;
+            pos += 2;
+        } else if (c == ';'){
+            pos++;
+            if (caseDepth > 0 && pos < n && (text.at(pos) == ';' || text.at(pos) == '&')){
+                // ;; ;& ;;& end a case item, a pattern follows
+                pos++;
+                if (pos < n && text.at(pos) == '&')
+                    pos++;
+                expectPattern = true;
+            }
+            commandPosition = true;
+        } else if (c == '<' && text.midRef(pos, 2) == "<<" && text.midRef(pos, 3) != "<<<"){
+            pos += 2;
+            pendingTabs = pos < n && text.at(pos) == '-';
+            if (pendingTabs)
+                pos++;
+            while (pos < n && text.at(pos).isSpace()){
+                pos++;
+            }
+            // the quotes of the delimiter only disable the expansions
+            QString word;
+            while (pos < n && !text.at(pos).isSpace() && (!isMeta(text.at(pos)) || text.at(pos) == '\'' || text.at(pos) == '"' || text.at(pos) == '\\')){
+                if (text.at(pos) != '\'' && text.at(pos) != '"' && text.at(pos) != '\\')
+                    word.append(text.at(pos));
+                pos++;
+            }
+            if (!word.isEmpty() && pending == 0)
+                pending = delimiterId(word);
+        } else if (isMeta(c) || c == '{' || c == '}' || c == '!'){
+            // | & ( { ! ` start a command, ) } < > don't
+            commandPosition = c == '|' || c == '&' || c == '(' || c == '{' || c == '!' || c == '`';
+            pos++;
+        } else {
+            int end = pos;
+            while (end < n && !text.at(end).isSpace() && !isMeta(text.at(end))){
+                end++;
+            }
+            const QString word = text.mid(pos, end-pos);
+            if (commandPosition && isKeyword(word)){
+                addToken(tokens, pos, end-pos, KEYWORD);
+                if (word == "case"){
+                    caseHeader = true;
+                } else if (word == "for" || word == "select"){
+                    forHeader = true;
+                } else if (word == "esac"){
+                    caseDepth = qMax(0, caseDepth-1);
+                }
+                // the command follows these ones
+                commandPosition = word != "case" && word != "for" && word != "select" && word != "function"
+                        && word != "esac" && word != "fi" && word != "done";
+            } else if (word == "in" && (caseHeader || forHeader)){
+                addToken(tokens, pos, end-pos, KEYWORD);
+                if (caseHeader){
+                    caseDepth = qMin(MAX_CASE_DEPTH, caseDepth+1);
+                    expectPattern = true;
+                }
+                caseHeader = forHeader = false;
+                commandPosition = false;
+            } else if (!(commandPosition && isAssignment(word))){
+                if (commandPosition && isCommand(word))
+                    addToken(tokens, pos, end-pos, COMMAND);
+                commandPosition = false;
+            }
+            pos = end;
+        }
+    }
+
+    if (mode == NORMAL && pending != 0){
+        mode = pendingTabs ? HEREDOC_TABS : HEREDOC_BODY;
+        heredoc = pending;
+    }
+    int ret = mode | (caseDepth << CASE_SHIFT) | (heredoc << DELIMITER_SHIFT);
+    if (continuation && mode == NORMAL)
+        ret |= CONTINUATION;
+    if (expectPattern)
+        ret |= EXPECT_PATTERN;
+    return ret;
+}
+
+int ShellLexer::delimiterId(const QString &delimiter)
+{
+    // the same delimiter always gives the same state
+    QMutexLocker lock(&delimitersMutex);
+    auto it = delimiterIds.find(delimiter);
+    if (it == delimiterIds.end()){
+        delimiters.append(delimiter);
+        it = delimiterIds.insert(delimiter, delimiters.size());
+    }
+    return it.value();
+}
+
+QString ShellLexer::delimiter(int id)
+{
+    QMutexLocker lock(&delimitersMutex);
+    return (id > 0 && id <= delimiters.size()) ? delimiters.at(id-1) : QString();
+}
+
+bool ShellLexer::isKeyword(const QString &word)
+{
+    static const QStringList keywords = QStringList() << "if" << "then" << "else" << "elif" << "fi"
+                                                      << "for" << "while" << "until" << "do" << "done"
+                                                      << "case" << "esac" << "select" << "function";
+    return keywords.contains(word);
+}
+
+bool ShellLexer::isCommand(const QString &word)
+{
+    static const QStringList commands = QStringList() << "ls" << "cd" << "mv"
+                                                      << "mkdir" << "rmdir" << "touch"
+                                                      << "rm" << "locate" << "clear"
+                                                      << "echo";
+    return commands.contains(word);
+}
+
+int ShellLexer::skipVariable(const QString &text, int pos)
+{
+    // pos is on the $, returns the position after the expansion
+    const int n = text.size();
+    int ret = pos+1;
+    if (ret < n){
+        const QChar c = text.at(ret);
+        if (c == '{'){
+            const int end = text.indexOf('}', ret);
+            ret = end == -1 ? n : end+1;
+        } else if (c == '('){
+            // only the opening is shown, the command is lexed as usual
+            ret++;
+        } else if (c.isLetter() || c == '_'){
+            while (ret < n && (text.at(ret).isLetterOrNumber() || text.at(ret) == '_')){
+                ret++;
+            }
+        } else if (c.isDigit() || QString("?@*#$!-").contains(c)){
+            ret++;
+        }
+    }
+    return ret;
+}
+
+int ShellLexer::skipDoubleQuoted(const QString &text, int pos, QVector<ShellLexer::Token> &tokens)
+{
+    // returns the position after the closing quote, -1 if the line ends before
+    const int n = text.size();
+    int ret = -1;
+    while (ret == -1 && pos < n){
+        const QChar c = text.at(pos);
+        if (c == '\\'){
+            pos += 2;
+        } else if (c == '"'){
+            ret = pos+1;
+        } else if (c == '$'){
+            const int end = skipVariable(text, pos);
+            addToken(tokens, pos, end-pos, VARIABLE);
+            pos = end;
+        } else {
+            pos++;
+        }
+    }
+    return ret;
+}
@@ -0,0 +1,39 @@
+#ifndef SHELLLEXER_H
+#define SHELLLEXER_H
+
+#include <QString>
+#include <QVector>
+
+/**
+ * @brief The ShellLexer class
+ * Tokenize a shell script line by line. What is still open at the end
+ * of a line (quote, here-document, case, continuation) is kept in the
+ * state given to the next line, so a line is lexed from the state of
+ * the previous one without reading the rest of the script.
+ */
+
+class ShellLexer
+{
+public:
+    enum TokenType { COMMENT=0, SHEBANG, KEYWORD, COMMAND, STRING, VARIABLE, HEREDOC, CASE_PATTERN, TOKEN_TYPES };
+    struct Token
+    {
+        int start;
+        int length;
+        TokenType type;
+    };
+    // state of the first line
+    static const int INITIAL = 0;
+    static int lexLine(const QString& text, int state, QVector<Token>& tokens);
+
+private:
+    static int delimiterId(const QString& delimiter);
+    static QString delimiter(int id);
+    static bool isKeyword(const QString& word);
+    static bool isCommand(const QString& word);
+    static int skipVariable(const QString& text, int pos);
+    static int skipDoubleQuoted(const QString& text, int pos, QVector<Token>& tokens);
+
+};
+
+#endif // SHELLLEXER_H
@@ -1,121 +1,300 @@
 #include "syntaxhighlighter.h"
+#include "scriptlexer.h"
 #include <QRegularExpressionMatchIterator>
+#include <QTextDocument>
+#include <QTextLayout>
+#include <QElapsedTimer>
+#include <QTimer>
+
+namespace {
+// characters inserted at once from which a script is lexed in background
+const int LARGE_CHANGE = 64*1024;
+// time given to the formats at each turn of the event loop
+const qint64 SLICE_DURATION = 8;
+// the lexing starts again once the typing pauses
+const int RESTART_DELAY = 100;
+}
 
 SyntaxHighLighter::SyntaxHighLighter(SyntaxType syntax, QTextDocument *parent)
-    : QSyntaxHighlighter(parent)
+    : QSyntaxHighlighter(static_cast<QObject*>(parent))
 {
-    switch (syntax) {
-    case KEY_VALUE:
-        initSyntaxKeyValue();
-        break;
-    case SECTION_VALUES:
-        initSyntaxSectionValues();
-        break;
-    case SCRIPT:
-        initSyntaxScript();
-        break;
-    default:
-        break;
-    }
+    highlightingRules = (syntax == SCRIPT) ? Q_NULLPTR : &rules(syntax);
+    deferred = false;
+    applying = false;
+    job = 0;
+    appliedCount = 0;
+    nextLine = 0;
+    visibleFirst = 0;
+    visibleCount = 0;
+    restartTimer = new QTimer(this);
+    restartTimer->setSingleShot(true);
+    connect(restartTimer, SIGNAL(timeout()), this, SLOT(startLexing()));
+    qRegisterMetaType<QVector<QVector<ShellLexer::Token> > >("QVector<QVector<ShellLexer::Token> >");
+    // connected before QSyntaxHighlighter, a large change is known before its blocks are highlighted
+    if (!highlightingRules && parent)
+        connect(parent, SIGNAL(contentsChange(int,int,int)), this, SLOT(documentChanged(int,int,int)));
+    setDocument(parent);
 }
 
 SyntaxHighLighter::~SyntaxHighLighter()
 {
-    highlightingRules.clear();
+    stopLexing();
+}
+
+void SyntaxHighLighter::setVisibleBlocks(int first, int count)
+{
+    visibleFirst = first;
+    visibleCount = count;
+    if (deferred)
+        scheduleApply();
 }
 
 void SyntaxHighLighter::highlightBlock(const QString &text)
 {
-    for (const HighlightingRule &rule : highlightingRules) {
-        QRegularExpressionMatchIterator matchIterator = rule.pattern.globalMatch(text);
+    if (!highlightingRules){
+        // the blocks of a large change are highlighted by applyLexed
+        if (!deferred)
+            highlightScript(text);
+    } else {
+        // the block is scanned once, whatever the number of rules
+        QRegularExpressionMatchIterator matchIterator = highlightingRules->pattern.globalMatch(text);
         while (matchIterator.hasNext()) {
             QRegularExpressionMatch match = matchIterator.next();
-            setFormat(match.capturedStart(), match.capturedLength(), rule.format);
+            // the captured group tells which rule matched
+            int rule = 0;
+            while (rule < highlightingRules->formats.size() && match.capturedStart(rule+1) == -1){
+                rule++;
+            }
+            if (rule < highlightingRules->formats.size())
+                setFormat(match.capturedStart(), match.capturedLength(), highlightingRules->formats.at(rule));
+        }
+    }
+}
+
+void SyntaxHighLighter::highlightScript(const QString &text)
+{
+    // lexed from the state of the previous line, the following lines are
+    // highlighted again by QSyntaxHighlighter only while the state changes
+    QVector<ShellLexer::Token> tokens;
+    const int previous = previousBlockState();
+    setCurrentBlockState(ShellLexer::lexLine(text, previous < 0 ? ShellLexer::INITIAL : previous, tokens));
+    const QVector<QTextCharFormat> &formats = scriptFormats();
+    for (const ShellLexer::Token &token : tokens){
+        setFormat(token.start, token.length, formats.at(token.type));
+    }
+}
+
+void SyntaxHighLighter::documentChanged(int position, int removed, int added)
+{
+    Q_UNUSED(position);
+    Q_UNUSED(removed);
+    if (deferred || added >= LARGE_CHANGE){
+        // the lines being lexed or applied don't match the document anymore
+        restartTimer->start(deferred ? RESTART_DELAY : 0);
+        deferred = true;
+        stopLexing();
+    }
+}
+
+void SyntaxHighLighter::startLexing()
+{
+    QTextDocument *doc = document();
+    if (doc){
+        applied = QVector<bool>(doc->blockCount(), false);
+        nextBlock = doc->begin();
+        ScriptLexer *lexer = new ScriptLexer(job, doc->toPlainText(), this);
+        connect(lexer, SIGNAL(linesLexed(int,QVector<int>,QVector<QVector<ShellLexer::Token> >)),
+                this, SLOT(linesLexed(int,QVector<int>,QVector<QVector<ShellLexer::Token> >)));
+        connect(lexer, SIGNAL(finished()), lexer, SLOT(deleteLater()));
+        lexer->start();
+    }
+}
+
+void SyntaxHighLighter::stopLexing()
+{
+    for (ScriptLexer *lexer : findChildren<ScriptLexer*>()){
+        lexer->requestInterruption();
+    }
+    // the batches already sent by the lexers are ignored
+    job++;
+    lexedStates.clear();
+    lexedTokens.clear();
+    applied.clear();
+    appliedCount = 0;
+    nextLine = 0;
+    nextBlock = QTextBlock();
+}
+
+void SyntaxHighLighter::linesLexed(int job, const QVector<int> &states, const QVector<QVector<ShellLexer::Token> > &tokens)
+{
+    if (job == this->job){
+        lexedStates += states;
+        lexedTokens += tokens;
+        scheduleApply();
+    }
+}
+
+void SyntaxHighLighter::scheduleApply()
+{
+    if (!applying){
+        applying = true;
+        QTimer::singleShot(0, this, SLOT(applyLexed()));
+    }
+}
+
+void SyntaxHighLighter::applyLexed()
+{
+    // a slice at a time so the events are still processed, the visible
+    // blocks first then the document in order
+    applying = false;
+    QElapsedTimer slice;
+    slice.start();
+    const int lexedCount = qMin(lexedStates.size(), applied.size());
+    const int visibleEnd = qMin(visibleFirst+visibleCount, lexedCount);
+    bool progress = true;
+    while (progress && !slice.hasExpired(SLICE_DURATION)){
+        int line = qMax(0, visibleFirst);
+        while (line < visibleEnd && applied.at(line)){
+            line++;
         }
+        if (line < visibleEnd){
+            applyLine(document()->findBlockByNumber(line), line);
+        } else {
+            while (nextLine < lexedCount && applied.at(nextLine)){
+                nextLine++;
+                nextBlock = nextBlock.next();
+            }
+            progress = nextLine < lexedCount;
+            if (progress)
+                applyLine(nextBlock, nextLine);
+        }
+    }
+    if (!applied.isEmpty() && appliedCount == applied.size()){
+        // the following changes are highlighted by QSyntaxHighlighter
+        // from the states left in the blocks
+        deferred = false;
+        stopLexing();
+    } else if (progress){
+        scheduleApply();
     }
 }
 
-void SyntaxHighLighter::initSyntaxKeyValue()
+void SyntaxHighLighter::applyLine(QTextBlock block, int line)
 {
-    HighlightingRule rule;
+    // what QSyntaxHighlighter does for a block, with the lexed tokens
+    if (block.isValid()){
+        const QVector<QTextCharFormat> &formats = scriptFormats();
+        QVector<QTextLayout::FormatRange> ranges;
+        for (const ShellLexer::Token &token : lexedTokens.at(line)){
+            QTextLayout::FormatRange range;
+            range.start = token.start;
+            range.length = token.length;
+            range.format = formats.at(token.type);
+            ranges.append(range);
+        }
+        block.layout()->setFormats(ranges);
+        block.setUserState(lexedStates.at(line));
+        document()->markContentsDirty(block.position(), block.length());
+    }
+    lexedTokens[line].clear();
+    applied[line] = true;
+    appliedCount++;
+}
+
+const SyntaxHighLighter::HighlightingRules &SyntaxHighLighter::rules(SyntaxType syntax)
+{
+    // compiled once and shared by all the editors
+    static const HighlightingRules keyValue = initSyntaxKeyValue();
+    static const HighlightingRules sectionValues = initSyntaxSectionValues();
+    const HighlightingRules *ret;
+    switch (syntax) {
+    case KEY_VALUE:
+        ret = &keyValue;
+        break;
+    case SECTION_VALUES:
+    default:
+        ret = &sectionValues;
+        break;
+    }
+    return *ret;
+}
 
+SyntaxHighLighter::HighlightingRules SyntaxHighLighter::initSyntaxKeyValue()
+{
+    QStringList patterns;
+    QVector<QTextCharFormat> formats;
     QTextCharFormat format;
 
+    // comment
+    format.setForeground(Qt::gray);
+    format.setFontWeight(QFont::Normal);
+    patterns << "^#.*$";
+    formats << format;
+
     // key
     format.setForeground(Qt::darkGreen);
     format.setFontWeight(QFont::Bold);
-    rule.pattern = QRegularExpression("^\\w+:");
-    rule.format = format;
-    highlightingRules.append(rule);
+    patterns << "^\\w+:";
+    formats << format;
 
-    // comment
-    format.setForeground(Qt::gray);
-    format.setFontWeight(QFont::Normal);
-    rule.pattern = QRegularExpression("^#.*$");
-    rule.format = format;
-    highlightingRules.append(rule);
+    return compile(patterns, formats);
 }
 
-void SyntaxHighLighter::initSyntaxSectionValues()
+SyntaxHighLighter::HighlightingRules SyntaxHighLighter::initSyntaxSectionValues()
 {
-    HighlightingRule rule;
-
+    QStringList patterns;
+    QVector<QTextCharFormat> formats;
     QTextCharFormat format;
 
+    // comment
+    format.setForeground(Qt::gray);
+    format.setFontWeight(QFont::Normal);
+    patterns << "^#.*$";
+    formats << format;
+
     // section
     format.setForeground(Qt::darkRed);
     format.setFontWeight(QFont::Bold);
-    rule.pattern = QRegularExpression("^\\[[\\w\\s]+\\]$");
-    rule.format = format;
-    highlightingRules.append(rule);
+    patterns << "^\\[[\\w\\s]+\\]$";
+    formats << format;
 
     // key
     format.setForeground(Qt::darkGreen);
     format.setFontWeight(QFont::Bold);
-    rule.pattern = QRegularExpression("^\\w+");
-    rule.format = format;
-    highlightingRules.append(rule);
+    patterns << "^\\w+";
+    formats << format;
 
-    // comment
-    format.setForeground(Qt::gray);
-    format.setFontWeight(QFont::Normal);
-    rule.pattern = QRegularExpression("^#.*$");
-    rule.format = format;
-    highlightingRules.append(rule);
+    return compile(patterns, formats);
 }
 
-void SyntaxHighLighter::initSyntaxScript()
+const QVector<QTextCharFormat> &SyntaxHighLighter::scriptFormats()
 {
-    // FIXME: contribute by improving this syntaxic coloration
-    HighlightingRule rule;
-
-    QTextCharFormat format;
-
-    // commands list
-    format.setForeground(Qt::darkBlue);
-    format.setFontWeight(QFont::Bold);
-    QStringList commandList;
-        commandList << "ls" << "cd" << "mv"
-                        << "mkdir" << "rmdir" << "touch"
-                        << "rm" << "locate" << "clear"
-                        << "echo";
-    foreach (const QString &pattern, commandList) {
-        rule.pattern = QRegularExpression("\\b"+pattern+"\\b");
-        rule.format = format;
-        highlightingRules.append(rule);
-    }
-
-    // shebang
-    format.setForeground(Qt::darkMagenta);
-    format.setFontWeight(QFont::Bold);
-    rule.pattern = QRegularExpression("^#!.*$");
-    rule.format = format;
-    highlightingRules.append(rule);
+    // one format per ShellLexer::TokenType
+    static const QVector<QTextCharFormat> formats = [](){
+        QVector<QTextCharFormat> ret(ShellLexer::TOKEN_TYPES);
+        ret[ShellLexer::COMMENT].setForeground(Qt::gray);
+        ret[ShellLexer::SHEBANG].setForeground(Qt::darkMagenta);
+        ret[ShellLexer::SHEBANG].setFontWeight(QFont::Bold);
+        ret[ShellLexer::KEYWORD].setForeground(Qt::darkRed);
+        ret[ShellLexer::KEYWORD].setFontWeight(QFont::Bold);
+        ret[ShellLexer::COMMAND].setForeground(Qt::darkBlue);
+        ret[ShellLexer::COMMAND].setFontWeight(QFont::Bold);
+        ret[ShellLexer::STRING].setForeground(Qt::darkGreen);
+        ret[ShellLexer::VARIABLE].setForeground(Qt::darkCyan);
+        ret[ShellLexer::HEREDOC].setForeground(Qt::darkGreen);
+        ret[ShellLexer::CASE_PATTERN].setForeground(Qt::darkYellow);
+        return ret;
+    }();
+    return formats;
+}
 
-    // comment
-    format.setForeground(Qt::gray);
-    format.setFontWeight(QFont::Normal);
-    rule.pattern = QRegularExpression("^#[^!].*$");
-    rule.format = format;
-    highlightingRules.append(rule);
+SyntaxHighLighter::HighlightingRules SyntaxHighLighter::compile(const QStringList &patterns, const QVector<QTextCharFormat> &formats)
+{
+    // the first alternative wins at a given position, so the rules that
+    // cover a whole line (comments) come before the words they contain
+    HighlightingRules ret;
+    ret.pattern = QRegularExpression("("+patterns.join(")|(")+")");
+    ret.pattern.optimize();
+    ret.formats = formats;
+    return ret;
 }
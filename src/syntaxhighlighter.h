@@ -1,13 +1,20 @@
 #ifndef SYNTAXHIGHLIGHTER_H
 #define SYNTAXHIGHLIGHTER_H
 
+#include "shelllexer.h"
 #include <QSyntaxHighlighter>
+#include <QTextBlock>
 #include <QVector>
 #include <QRegularExpression>
 
+class QTimer;
+
 /**
  * @brief The SyntaxHighLighter class
- * To perform a Syntaxic coloration when editing files
+ * To perform a Syntaxic coloration when editing files.
+ * A large change of a script (paste, loading) is lexed in background by
+ * the ScriptLexer, the formats are then applied by slices, the visible
+ * blocks first, so the editor is not frozen.
  */
 
 class SyntaxHighLighter : public QSyntaxHighlighter
@@ -18,20 +25,50 @@ public:
 
     SyntaxHighLighter(SyntaxType syntax, QTextDocument *parent = 0);
     ~SyntaxHighLighter();
+    // the blocks shown by the editor are highlighted first
+    void setVisibleBlocks(int first, int count);
 
 protected:
     virtual void highlightBlock(const QString &text);
 
+private slots:
+    void documentChanged(int position, int removed, int added);
+    void startLexing();
+    void linesLexed(int job, const QVector<int> &states, const QVector<QVector<ShellLexer::Token> > &tokens);
+    void applyLexed();
+
 private:
-    void initSyntaxKeyValue();
-    void initSyntaxSectionValues();
-    void initSyntaxScript();
-    struct HighlightingRule
+    struct HighlightingRules
     {
+        // one alternative per rule, the format of a match is the one of its group
         QRegularExpression pattern;
-        QTextCharFormat format;
+        QVector<QTextCharFormat> formats;
     };
-    QVector<HighlightingRule> highlightingRules;
+    static const HighlightingRules &rules(SyntaxType syntax);
+    static HighlightingRules initSyntaxKeyValue();
+    static HighlightingRules initSyntaxSectionValues();
+    static HighlightingRules compile(const QStringList &patterns, const QVector<QTextCharFormat> &formats);
+    static const QVector<QTextCharFormat> &scriptFormats();
+    void highlightScript(const QString &text);
+    // null for the scripts, see ShellLexer
+    const HighlightingRules *highlightingRules;
+    void scheduleApply();
+    void applyLine(QTextBlock block, int line);
+    void stopLexing();
+    // the blocks are left to the ScriptLexer while true
+    bool deferred;
+    bool applying;
+    int job;
+    QTimer *restartTimer;
+    QVector<int> lexedStates;
+    QVector<QVector<ShellLexer::Token> > lexedTokens;
+    QVector<bool> applied;
+    int appliedCount;
+    // first line not applied yet, in order
+    int nextLine;
+    QTextBlock nextBlock;
+    int visibleFirst;
+    int visibleCount;
 
 };
 
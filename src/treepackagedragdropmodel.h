@@ -2,11 +2,17 @@
 #define TREEMODEL_H
 
 #include <QAbstractItemModel>
+#include <QHash>
+#include <QSet>
+#include "persistenttree.h"
 
 class AbstractFile;
 class Folder;
 class RealFile;
 class FileSignatureInfo;
+class NodeArena;
+class SearchIndex;
+struct ScannedFile;
 
 /**
  * @brief The TreePackageDragDropModel class
@@ -21,6 +27,9 @@ public:
     TreePackageDragDropModel(QObject *parent = Q_NULLPTR);
     ~TreePackageDragDropModel();
     void resetToDefault();
+    void adoptTree(NodeArena *arena, Folder *root, const QVector<RealFile *>& files, const QSet<quint64>& packageFolders);
+    static Folder *createSkeleton(NodeArena *arena, const std::string& name);
+    static bool isPackageFolder(const QStringList& segments, int idx, const QString& packageName);
     virtual QModelIndex	index(int row, int column = 0, const QModelIndex &parent = QModelIndex()) const;
     virtual QModelIndex	parent(const QModelIndex &index) const;
     virtual QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
@@ -33,12 +42,31 @@ public:
     virtual Qt::ItemFlags flags(const QModelIndex &index) const;
     virtual int	rowCount(const QModelIndex &parent = QModelIndex()) const;
     virtual int	columnCount(const QModelIndex &parent = QModelIndex()) const;
+    virtual bool hasChildren(const QModelIndex &parent = QModelIndex()) const;
+    virtual bool canFetchMore(const QModelIndex &parent) const;
+    virtual void fetchMore(const QModelIndex &parent);
     QModelIndex indexByAbstractFile(AbstractFile *internal);
-    void addFileInfo(FileSignatureInfo *fsi);
-    void addFileInfo(const QString& path, FileSignatureInfo *fsi);
+    void addFileInfo(const FileSignatureInfo& info);
+    void addFileInfo(const QString& path, const FileSignatureInfo& info);
+    // the infos must be allocated by getArena(), they are released with it
+    void addFileInfos(const QString& path, const QVector<FileSignatureInfo *>& infos);
+    QVector<quint64> addFileInfos(quint64 folder, const QVector<FileSignatureInfo *>& infos);
+    static QString destinationFolder(FileSignatureInfo& fsi, const QString& packageName);
     QVector<RealFile *> getFileFromUser();
     QVector<RealFile *> getFileFromProgram();
     Folder *getRoot();
+    NodeArena *getArena();
+    QModelIndexList find(const QString& query, int max);
+    PersistentTree::NodePtr snapshot() const;
+    // the whole tree, with DEBIAN and the files written by the program,
+    // the files of the BlobStore storeDir are given their stored copy
+    PersistentTree::NodePtr liveSnapshot(const QString& storeDir) const;
+    // the edits replayed from the journal, the nodes are given by id
+    // as sibling folders can have the same name
+    quint64 addFolder(quint64 parent, const QString& name, bool canRename);
+    void removeNode(quint64 id);
+    void moveNode(quint64 id, quint64 folder);
+    void renameNode(quint64 id, const QString& name);
 
 public slots:
     void addScriptFile(const QString& name);
@@ -47,17 +75,71 @@ public slots:
     void changePackageName(const QString &pname);
     void createFolder(const QModelIndex &index);
     void removeFolder(const QModelIndex &index);
+    void addScannedFiles(int scan, const QVector<ScannedFile> &files);
+    void undo();
+    void redo();
 
 signals:
     void changeDesktopTab(const QString &oldname, const QString &newname);
+    void undoAvailable(bool available);
+    void redoAvailable(bool available);
+    // the edits of the user, to be journaled
+    void folderAdded(quint64 id, quint64 parent, const QString &path, bool canRename);
+    void filesAdded(quint64 folder, const QVector<quint64> &ids, const QVector<FileSignatureInfo*> &infos);
+    void nodeRemoved(quint64 id);
+    void nodeMoved(quint64 id, quint64 folder);
+    void nodeRenamed(quint64 id, const QString &name);
+    void treeReplaced();
 
 private:
+    void createDefaultTree();
+    void indexTree();
+    void clearState();
+    Folder *ensureFolder(const QString& path, Folder *from = Q_NULLPTR);
+    Folder *appendFolder(Folder *parent, const std::string& name);
+    QVector<quint64> addFiles(Folder *f, const QVector<FileSignatureInfo *>& infos);
+    void moveFile(RealFile *rf, Folder *folder);
+    void forgetSubtree(AbstractFile *af);
+    Folder *folderAt(const QModelIndex& index) const;
+    int loadedRows(Folder *f) const;
+    bool isExposed(AbstractFile *af) const;
+    int beginAppendRows(Folder *f, int count);
+    void endAppendRows(Folder *f, int added);
+    bool beginRemoveChild(AbstractFile *af);
+    void endRemoveChild(Folder *parent, bool removed);
+    QModelIndex reveal(AbstractFile *af);
+    void nodeChanged(AbstractFile *af);
+    void checkpoint();
+    void restoreSnapshot(const PersistentTree::NodePtr& target);
+    struct SyncState
+    {
+        // removed from a folder, they may be added in another one
+        QHash<quint64, AbstractFile*> detached;
+        // kept as they are, to mirror again after the restore
+        QVector<AbstractFile*> kept;
+        QVector<AbstractFile*> renamed;
+    };
+    void syncFolder(Folder *live, const PersistentTree::NodePtr& from, const PersistentTree::NodePtr& to, SyncState& state);
+    AbstractFile *createFromSnapshot(const PersistentTree::NodePtr& node);
+    bool holdsProgramFile(AbstractFile *af);
+    void detach(AbstractFile *af);
+    void attach(Folder *f, AbstractFile *af);
     virtual QVariant displayRole(const QModelIndex &index) const;
     virtual QVariant decorationRole(const QModelIndex &index) const;
     virtual QVariant toolTipRole(const QModelIndex &index) const;
+    NodeArena *arena;
+    SearchIndex *searchIndex;
+    PersistentTree *history;
+    QVector<PersistentTree::NodePtr> undoStack;
+    QVector<PersistentTree::NodePtr> redoStack;
     Folder *tree;
     QVector<RealFile*> fileFromUser;
     QVector<RealFile*> fileFromProgram;
+    int scan;
+    // rows of each folder given to the view, see fetchMore()
+    mutable QHash<const Folder*, int> loaded;
+    // ids of the usr/share/<package> folders, renamed with the package
+    QSet<quint64> packageFolders;
 
 };
 
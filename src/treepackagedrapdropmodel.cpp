@@ -2,37 +2,92 @@
 #include "folder.h"
 #include "realfile.h"
 #include "filesignatureinfo.hpp"
+#include "nodearena.h"
+#include "filescanner.h"
+#include "searchindex.h"
+#include "blobstore.h"
 #include <QIcon>
 #include <QFileInfo>
+#include <QImageReader>
+#include <QHash>
 #include <QMimeData>
 #include <QUrl>
+#include <QSet>
+#include <algorithm>
+
+namespace {
+// rows given to the view at once in a folder
+const int FETCH_BATCH = 256;
+
+QString formatSize(long long bytes)
+{
+    QString ret;
+    if (bytes < 1024){
+        ret = QString("%1 B").arg(bytes);
+    } else if (bytes < 1024*1024){
+        ret = QString("%1 KiB").arg(bytes/1024.0, 0, 'f', 1);
+    } else if (bytes < 1024LL*1024*1024){
+        ret = QString("%1 MiB").arg(bytes/(1024.0*1024), 0, 'f', 1);
+    } else {
+        ret = QString("%1 GiB").arg(bytes/(1024.0*1024*1024), 0, 'f', 1);
+    }
+    return ret;
+}
+}
 
 TreePackageDragDropModel::TreePackageDragDropModel(QObject *parent)
     : QAbstractItemModel(parent)
 {
-    // default tree of a debian package
-    tree = new Folder("packagename");
-    tree->add(new Folder("DEBIAN", false)).add(new RealFile("control", false));
-    tree->add(new Folder("usr", false)).add(new Folder("bin", false));
+    qRegisterMetaType<QVector<ScannedFile> >("QVector<ScannedFile>");
+    scan = 0;
+    arena = new NodeArena();
+    searchIndex = new SearchIndex(arena);
+    history = new PersistentTree();
+    createDefaultTree();
 }
 
 TreePackageDragDropModel::~TreePackageDragDropModel()
 {
-    delete tree;
-    // all the RealFile* contained in the list are already deleted by the "delete tree;"
+    // all the RealFile* contained in the list are released with the arena
     fileFromUser.clear();
     fileFromProgram.clear();
+    delete searchIndex;
+    delete history;
+    delete arena;
 }
 
 void TreePackageDragDropModel::resetToDefault()
 {
     beginResetModel();
-    delete tree;
-    fileFromUser.clear();
-    tree = new Folder("packagename");
-    tree->add(new Folder("DEBIAN", false)).add(new RealFile("control", false));
-    tree->add(new Folder("usr", false)).add(new Folder("bin", false));
+    clearState();
+    // release the whole tree at once
+    searchIndex->clear();
+    arena->clear();
+    createDefaultTree();
+    endResetModel();
+    emit undoAvailable(false);
+    emit redoAvailable(false);
+    emit treeReplaced();
+}
+
+void TreePackageDragDropModel::adoptTree(NodeArena *arena, Folder *root, const QVector<RealFile *> &files, const QSet<quint64> &packageFolders)
+{
+    // the tree was built in background, one reset whatever its size
+    beginResetModel();
+    clearState();
+    delete searchIndex;
+    delete this->arena;
+    this->arena = arena;
+    tree = root;
+    fileFromUser = files;
+    this->packageFolders = packageFolders;
+    searchIndex = new SearchIndex(arena);
+    indexTree();
     endResetModel();
+    emit undoAvailable(false);
+    emit redoAvailable(false);
+    emit headerDataChanged(Qt::Horizontal, 0, 0);
+    emit treeReplaced();
 }
 
 QModelIndex TreePackageDragDropModel::index(int row, int column, const QModelIndex &parent) const
@@ -45,7 +100,7 @@ QModelIndex TreePackageDragDropModel::index(int row, int column, const QModelInd
         } else {
             parentItem = tree; // root
         }
-        if(Folder* f = dynamic_cast<Folder*>(parentItem)) {
+        if(Folder* f = parentItem->toFolder()) {
            ret = createIndex(row, column, f->child(row));
         }
     }
@@ -58,8 +113,9 @@ QModelIndex TreePackageDragDropModel::parent(const QModelIndex &index) const
     if (index.isValid()){
         AbstractFile *child = static_cast<AbstractFile*>(index.internalPointer());
         AbstractFile *parent = child->getParent();
-        if (parent && parent != child){
-            ret = createIndex(1, 0, parent);
+        // the root folder is the invisible root item
+        if (parent && parent != tree){
+            ret = createIndex(parent->getRow(), 0, parent);
         }
     }
     return ret;
@@ -96,7 +152,7 @@ QVariant TreePackageDragDropModel::headerData(int section, Qt::Orientation orien
     if (orientation == Qt::Horizontal){
         switch (role) {
         case Qt::DisplayRole:
-            ret = QString("Package name: %1").arg(tree->getName().c_str());
+            ret = QString("Package name: %1 (%2 files, %3)").arg(tree->getDisplayName()).arg(tree->countFiles()).arg(formatSize(tree->getSize()));
             break;
         default:
             break;
@@ -110,7 +166,14 @@ bool TreePackageDragDropModel::setData(const QModelIndex &index, const QVariant
     bool ret = false;
     if (index.isValid() && role == Qt::EditRole){
         AbstractFile *af = static_cast<AbstractFile*>(index.internalPointer());
-        af->setName(value.toString().toStdString());
+        const std::string name = value.toString().toStdString();
+        if (af->isRenamable() && name != af->getName()){
+            checkpoint();
+            af->setName(name);
+            searchIndex->rename(af);
+            history->rename(af);
+            emit nodeRenamed(af->getId(), value.toString());
+        }
         ret = true;
     }
     return ret;
@@ -123,12 +186,15 @@ bool TreePackageDragDropModel::canDropMimeData(const QMimeData *data, Qt::DropAc
     Q_UNUSED(column);
     bool ret = false;
     if (data->hasUrls()){
-        // from filesystem
-        ret = QFileInfo(data->urls().first().path()).isFile();
+        // from filesystem, files and directories
+        const QList<QUrl> urls = data->urls();
+        for (int i=0; i<urls.size() && !ret; i++){
+            ret = urls.at(i).isLocalFile() && QFileInfo::exists(urls.at(i).toLocalFile());
+        }
     } else {
         // from tree
         if (parent.isValid()){
-            if (Folder *parent_f = static_cast<Folder*>(parent.internalPointer())){
+            if (Folder *parent_f = static_cast<AbstractFile*>(parent.internalPointer())->toFolder()){
                 if (parent_f != tree && parent_f->getName() != "DEBIAN")
                     ret = true;
             }
@@ -144,33 +210,38 @@ bool TreePackageDragDropModel::dropMimeData(const QMimeData *data, Qt::DropActio
     Q_UNUSED(column);
     bool ret = false;
     if (data->hasUrls()){
-        // add from filesystem
-        FileSignatureInfo *fsi = new FileSignatureInfo(data->urls().first().path().toStdString());
-        int before = tree->count(true);
-        addFileInfo(fsi);
-        if (before < tree->count(true)){
+        // add from filesystem, the files are classified and the
+        // directories keep their structure under the targeted folder
+        QStringList paths;
+        for (const QUrl &url : data->urls()){
+            if (url.isLocalFile())
+                paths.append(url.toLocalFile());
+        }
+        quint64 target = 0;
+        if (parent.isValid()){
+            AbstractFile *af = static_cast<AbstractFile*>(parent.internalPointer());
+            if (af->isFolder() && !tree->getChild<Folder*>("DEBIAN")->isAncestorOf(af) && af->getName() != "DEBIAN")
+                target = af->getId();
+        }
+        if (!paths.isEmpty()){
+            checkpoint();
+            FileScanner *scanner = new FileScanner(scan, paths, target, tree->getDisplayName(), this);
+            connect(scanner, SIGNAL(filesFound(int,QVector<ScannedFile>)), this, SLOT(addScannedFiles(int,QVector<ScannedFile>)));
+            connect(scanner, SIGNAL(finished()), scanner, SLOT(deleteLater()));
+            scanner->start();
             ret = true;
-        } else {
-            delete fsi;
         }
     } else {
         // move from tree
         if (parent.isValid() && data->formats().first() == "debpac/realfile"){
-            const QString realfile_ptr = data->text();
-            qintptr rf_ptr = realfile_ptr.toLong(nullptr, 16);
-            RealFile *rf = reinterpret_cast<RealFile*>(rf_ptr);
+            // a stale handle is resolved to nullptr
+            AbstractFile *af = arena->resolve(data->text().toULongLong());
+            RealFile *rf = af ? af->toRealFile() : Q_NULLPTR;
             if (rf){
-                QModelIndex old = indexByAbstractFile(rf);
-                if (old.isValid()){
-                    beginRemoveRows(old.parent(), old.row(), old.row());
-                    tree->getChild<Folder*>("usr")->remove(rf, true);
-                    endRemoveRows();
-                    Folder *new_emplacement = static_cast<Folder*>(parent.internalPointer());
-                    if (new_emplacement){
-                        beginInsertRows(parent, new_emplacement->count(false), new_emplacement->count(false));
-                        new_emplacement->add(rf);
-                        endInsertRows();
-                    }
+                Folder *new_emplacement = static_cast<AbstractFile*>(parent.internalPointer())->toFolder();
+                if (new_emplacement){
+                    checkpoint();
+                    moveFile(rf, new_emplacement);
                 }
             }
         }
@@ -182,9 +253,9 @@ QMimeData *TreePackageDragDropModel::mimeData(const QModelIndexList &indexes) co
 {
     QMimeData *mimeData = QAbstractItemModel::mimeData(indexes);
     if (indexes.first().isValid()){
-        RealFile *rf = static_cast<RealFile*>(indexes.first().internalPointer());
-        if (rf){
-            mimeData->setText(QString("0x%1").arg((qintptr) rf, QT_POINTER_SIZE, 16, QChar('0')));
+        AbstractFile *af = static_cast<AbstractFile*>(indexes.first().internalPointer());
+        if (af){
+            mimeData->setText(QString::number(arena->handle(af)));
         }
     }
     return mimeData;
@@ -202,14 +273,11 @@ Qt::ItemFlags TreePackageDragDropModel::flags(const QModelIndex &index) const
     Qt::ItemFlags ret = QAbstractItemModel::flags(index);
     if (index.isValid()){
         AbstractFile *af = static_cast<AbstractFile*>(index.internalPointer());
-        if (RealFile *rf = dynamic_cast<RealFile*>(af)){
-            if (rf->getParent()->getName() != "DEBIAN"){
-                ret |= Qt::ItemIsDragEnabled;
-            }
-        }
-        if (Folder *f = dynamic_cast<Folder*>(af)){
-            if (f->getName() != "DEBIAN")
+        if (af->isFolder()){
+            if (af->getName() != "DEBIAN")
                 ret |= Qt::ItemIsDropEnabled;
+        } else if (af->getParent()->getName() != "DEBIAN"){
+            ret |= Qt::ItemIsDragEnabled;
         }
         if (af->isRenamable()){
             ret |= Qt::ItemIsEditable;
@@ -222,22 +290,39 @@ Qt::ItemFlags TreePackageDragDropModel::flags(const QModelIndex &index) const
 
 int TreePackageDragDropModel::rowCount(const QModelIndex &parent) const
 {
-    Q_UNUSED(parent);
     int ret = 0;
-    AbstractFile *parentItem = static_cast<AbstractFile*>(parent.internalPointer());
-    if (parent.isValid()){
-        if(Folder* f = dynamic_cast<Folder*>(parentItem)) {
-            ret = f->count(false);
-        } else {
-            ret = 0;
-        }
-    } else {
-        // root
-        ret = tree->count(false);
+    if (Folder *f = folderAt(parent)){
+        // only the fetched rows, see fetchMore()
+        ret = loadedRows(f);
     }
     return ret;
 }
 
+bool TreePackageDragDropModel::hasChildren(const QModelIndex &parent) const
+{
+    Folder *f = folderAt(parent);
+    return f && f->count(false) > 0;
+}
+
+bool TreePackageDragDropModel::canFetchMore(const QModelIndex &parent) const
+{
+    Folder *f = folderAt(parent);
+    return f && loadedRows(f) < f->count(false);
+}
+
+void TreePackageDragDropModel::fetchMore(const QModelIndex &parent)
+{
+    if (Folder *f = folderAt(parent)){
+        const int rows = loadedRows(f);
+        const int fetch = qMin(FETCH_BATCH, f->count(false)-rows);
+        if (fetch > 0){
+            beginInsertRows(parent, rows, rows+fetch-1);
+            loaded[f] += fetch;
+            endInsertRows();
+        }
+    }
+}
+
 int TreePackageDragDropModel::columnCount(const QModelIndex &parent) const
 {
     Q_UNUSED(parent);
@@ -246,83 +331,87 @@ int TreePackageDragDropModel::columnCount(const QModelIndex &parent) const
 
 QModelIndex TreePackageDragDropModel::indexByAbstractFile(AbstractFile *internal)
 {
-    Folder *parent = dynamic_cast<Folder*>(internal->getParent());
-    QModelIndex ret = createIndex(parent->child(internal), 0, internal);
+    QModelIndex ret;
+    if (internal && internal != tree && internal->hasParent()){
+        ret = createIndex(internal->getRow(), 0, internal);
+    }
+    return ret;
+}
+
+void TreePackageDragDropModel::addFileInfo(const FileSignatureInfo &info)
+{
+    FileSignatureInfo *fsi = arena->createFileSignatureInfo(info);
+    addFileInfos(destinationFolder(*fsi, tree->getDisplayName()), QVector<FileSignatureInfo*>() << fsi);
+}
+
+void TreePackageDragDropModel::addFileInfo(const QString &path, const FileSignatureInfo &info)
+{
+    // copied in the arena, it releases the info with the node
+    addFileInfos(path, QVector<FileSignatureInfo*>() << arena->createFileSignatureInfo(info));
+}
+
+void TreePackageDragDropModel::addFileInfos(const QString &path, const QVector<FileSignatureInfo *> &infos)
+{
+    addFiles(ensureFolder(path), infos);
+}
+
+QVector<quint64> TreePackageDragDropModel::addFileInfos(quint64 folder, const QVector<FileSignatureInfo *> &infos)
+{
+    AbstractFile *af = arena->find(folder);
+    return addFiles(af && tree->isAncestorOf(af) ? af->toFolder() : Q_NULLPTR, infos);
+}
+
+QVector<quint64> TreePackageDragDropModel::addFiles(Folder *f, const QVector<FileSignatureInfo *> &infos)
+{
+    QVector<quint64> ret;
+    if (f && !infos.isEmpty()){
+        // one insertion for all the files of the folder
+        int added = beginAppendRows(f, infos.size());
+        std::vector<AbstractFile*> files;
+        for (FileSignatureInfo *fsi : infos){
+            RealFile *rf = arena->createFile(QFileInfo(fsi->getPath().c_str()).completeBaseName().toStdString(), false, fsi);
+            f->add(rf);
+            searchIndex->insert(rf);
+            fileFromUser.append(rf);
+            files.push_back(rf);
+            ret.append(rf->getId());
+        }
+        history->add(f, files);
+        endAppendRows(f, added);
+        emit headerDataChanged(Qt::Horizontal, 0, 0);
+        emit filesAdded(f->getId(), ret, infos);
+    }
     return ret;
 }
 
-void TreePackageDragDropModel::addFileInfo(FileSignatureInfo *fsi)
+QString TreePackageDragDropModel::destinationFolder(FileSignatureInfo &fsi, const QString &packageName)
 {
+    // called by the FileScanner thread, QImageReader can be used outside the GUI thread
     QString folder;
-    switch (fsi->getCategory()) {
+    switch (fsi.getCategory()) {
     case FileSignatureInfo::BINARY:
         folder = "usr/bin";
         break;
     case FileSignatureInfo::AUDIO:
-        folder = "usr/share/"+QString(tree->getName().c_str())+"/sounds";
+        folder = "usr/share/"+packageName+"/sounds";
         break;
     case FileSignatureInfo::IMAGE:
-        if (QPixmap(fsi->getPath().c_str()).width() == QPixmap(fsi->getPath().c_str()).height()){
-            folder = "usr/share/icons/hicolor/"+QString("%1x%1").arg(QPixmap(fsi->getPath().c_str()).width())+"/apps";
+    {
+        const QSize size = QImageReader(fsi.getPath().c_str()).size();
+        if (size.width() == size.height()){
+            folder = "usr/share/icons/hicolor/"+QString("%1x%1").arg(size.width())+"/apps";
         } else {
-            folder = "usr/share/"+QString(tree->getName().c_str())+"/images";
+            folder = "usr/share/"+packageName+"/images";
         }
         break;
-    case FileSignatureInfo::PACKAGE:
-    case FileSignatureInfo::ARCHIVE:
-    default:
-        folder = "usr/share/"+QString(tree->getName().c_str());
-        break;
     }
-    if (!folder.isEmpty()){
-        addFileInfo(folder, fsi);
-    }
-}
-
-void TreePackageDragDropModel::addFileInfo(const QString &path, FileSignatureInfo *fsi)
-{
-    QModelIndex parentIndex = index(0);
-    int renameFolderIndex = -1;
-    switch (fsi->getCategory()) {
     case FileSignatureInfo::PACKAGE:
     case FileSignatureInfo::ARCHIVE:
-    case FileSignatureInfo::AUDIO:
-    case FileSignatureInfo::UNKNOW:
-        renameFolderIndex = 2;
-        break;
-    case FileSignatureInfo::IMAGE:
-        if (!(QPixmap(fsi->getPath().c_str()).width() == QPixmap(fsi->getPath().c_str()).height())){
-            renameFolderIndex = 2;
-        }
-        break;
     default:
+        folder = "usr/share/"+packageName;
         break;
     }
-    int idx = 0;
-    QStringList sl = path.split("/");
-    Folder *f = tree;
-    for (QString s : sl){
-        if (Folder *current = f->getChild<Folder*>(s.toStdString())){
-            f = current;
-        } else {
-            int at = f->count(false);
-            beginInsertRows(parentIndex, at, at);
-            Folder *nf = new Folder(s.toStdString(), idx==renameFolderIndex);
-            f->add(nf);
-            f = nf;
-            endInsertRows();
-        }
-        parentIndex = indexByAbstractFile(f);
-        idx++;
-    }
-    if (f){
-        int at = f->count(false);
-        beginInsertRows(parentIndex, at, at);
-        RealFile *rf = new RealFile(QFileInfo(fsi->getPath().c_str()).completeBaseName().toStdString().c_str(), false, fsi);
-        f->add(rf);
-        fileFromUser.append(rf);
-        endInsertRows();
-    }
+    return folder;
 }
 
 QVector<RealFile *> TreePackageDragDropModel::getFileFromUser()
@@ -340,17 +429,47 @@ Folder *TreePackageDragDropModel::getRoot()
     return tree;
 }
 
+NodeArena *TreePackageDragDropModel::getArena()
+{
+    return arena;
+}
+
+PersistentTree::NodePtr TreePackageDragDropModel::snapshot() const
+{
+    return history->snapshot();
+}
+
+PersistentTree::NodePtr TreePackageDragDropModel::liveSnapshot(const QString &storeDir) const
+{
+    // as MainWindow::generatePackage, the stored bytes are shipped
+    const BlobStore store(storeDir);
+    return PersistentTree::build(tree, [&store, &storeDir](FileSignatureInfo &fsi){
+        const QString content = QString::fromStdString(fsi.getContent());
+        return !storeDir.isEmpty() && store.contains(content) ? store.pathOf(content).toStdString() : std::string();
+    });
+}
+
+QModelIndexList TreePackageDragDropModel::find(const QString &query, int max)
+{
+    QModelIndexList ret;
+    for (AbstractFile *af : searchIndex->find(query.toStdString(), tree, max)){
+        ret.append(reveal(af));
+    }
+    return ret;
+}
+
 void TreePackageDragDropModel::addScriptFile(const QString &name)
 {
     Folder *debian = tree->getChild<Folder*>("DEBIAN");
     if (debian){
         if (!debian->containFile(name.toStdString())){
-            int at = debian->count(false);
-            beginInsertRows(index(1), at, at);
-            RealFile *rf = new RealFile(name.toStdString(), false);
+            int added = beginAppendRows(debian, 1);
+            RealFile *rf = arena->createFile(name.toStdString(), false);
             debian->add(rf);
+            searchIndex->insert(rf);
             fileFromProgram.append(rf);
-            endInsertRows();
+            endAppendRows(debian, added);
+            emit headerDataChanged(Qt::Horizontal, 0, 0);
         }
     }
 }
@@ -363,47 +482,71 @@ void TreePackageDragDropModel::removeScriptFile(const QString &name)
             removedFile = fileFromProgram.at(i);
         }
     }
-    QModelIndex index = indexByAbstractFile(removedFile);
-    if (index.isValid()){
-        beginRemoveRows(index.parent(), index.row(), index.row());
-        Folder *parent = static_cast<Folder*>(index.parent().internalPointer());
-        if (parent){
-            if (parent->remove(removedFile, false)){
-                fileFromProgram.remove(fileFromProgram.indexOf(removedFile));
-                delete removedFile;
-            }
+    if (removedFile){
+        Folder *parent = removedFile->getParent()->toFolder();
+        bool removed = beginRemoveChild(removedFile);
+        if (parent->remove(removedFile, false)){
+            searchIndex->remove(removedFile);
+            fileFromProgram.remove(fileFromProgram.indexOf(removedFile));
+            arena->destroy(removedFile);
         }
-        endRemoveRows();
+        endRemoveChild(parent, removed);
+        emit headerDataChanged(Qt::Horizontal, 0, 0);
     }
 }
 
 void TreePackageDragDropModel::addDesktopFile(const QString &name)
 {
     Q_UNUSED(name);
-    QModelIndex parentIndex = index(0);
-    QString folder = "usr/share/applications";
-    QStringList sl = folder.split("/");
-    Folder *f = tree;
-    for (QString s : sl){
-        if (Folder *current = f->getChild<Folder*>(s.toStdString())){
-            f = current;
-        } else {
-            int at = f->count(false);
-            beginInsertRows(parentIndex, at, at);
-            Folder *nf = new Folder(s.toStdString(), false);
-            f->add(nf);
-            f = nf;
-            endInsertRows();
-        }
-        parentIndex = index(0, 0, parentIndex);
-    }
+    Folder *f = ensureFolder("usr/share/applications");
     if (f && !f->containFile(tree->getName()+".desktop")){
-        int at = f->count(false);
-        beginInsertRows(parentIndex, at, at);
-        RealFile *rf = new RealFile(tree->getName()+".desktop", true);
+        int added = beginAppendRows(f, 1);
+        RealFile *rf = arena->createFile(tree->getName()+".desktop", true);
         f->add(rf);
+        searchIndex->insert(rf);
         fileFromProgram.append(rf);
-        endInsertRows();
+        endAppendRows(f, added);
+        emit headerDataChanged(Qt::Horizontal, 0, 0);
+    }
+}
+
+void TreePackageDragDropModel::addScannedFiles(int scan, const QVector<ScannedFile> &files)
+{
+    // the results of a scan started before a reset are ignored
+    if (scan == this->scan){
+        QHash<QPair<quint64, QString>, QVector<FileSignatureInfo*> > byFolder;
+        for (const ScannedFile &sf : files){
+            byFolder[qMakePair(sf.target, sf.folder)].append(arena->createFileSignatureInfo(sf.info));
+        }
+        for (auto it = byFolder.constBegin(); it != byFolder.constEnd(); it++){
+            // under the folder dropped on, not a sibling with the same path,
+            // nothing is added if it was removed during the scan
+            AbstractFile *target = it.key().first ? arena->find(it.key().first) : tree;
+            if (target && target->isFolder() && (target == tree || tree->isAncestorOf(target)))
+                addFiles(ensureFolder(it.key().second, target->toFolder()), it.value());
+        }
+    }
+}
+
+void TreePackageDragDropModel::undo()
+{
+    if (!undoStack.isEmpty()){
+        redoStack.append(history->snapshot());
+        restoreSnapshot(undoStack.takeLast());
+        emit undoAvailable(!undoStack.isEmpty());
+        emit redoAvailable(true);
+        emit treeReplaced();
+    }
+}
+
+void TreePackageDragDropModel::redo()
+{
+    if (!redoStack.isEmpty()){
+        undoStack.append(history->snapshot());
+        restoreSnapshot(redoStack.takeLast());
+        emit undoAvailable(true);
+        emit redoAvailable(!redoStack.isEmpty());
+        emit treeReplaced();
     }
 }
 
@@ -412,11 +555,31 @@ void TreePackageDragDropModel::changePackageName(const QString &pname)
     if (Folder *apps_folder = tree->containFolder("applications", true)){
         if (RealFile *desktop = apps_folder->containFile(tree->getName()+".desktop")){
             desktop->setName(pname.toStdString()+".desktop");
-            emit changeDesktopTab(tree->getName().c_str(), pname);
+            searchIndex->rename(desktop);
+            nodeChanged(desktop);
+            emit changeDesktopTab(tree->getDisplayName(), pname);
         }
     }
-    tree->renameFolder(tree->getName(), pname.toStdString(), true);
-    emit headerDataChanged(Qt::Horizontal, 0, 0);
+    // only the root and the usr/share/<package> folders are renamed, if
+    // the user didn't rename them; the removed ones are kept as they are,
+    // an undo can bring them back
+    const std::string name = pname.toStdString();
+    if (name != tree->getName()){
+        const std::string oldname = tree->getName();
+        tree->setName(name);
+        history->rename(tree);
+        for (quint64 id : packageFolders){
+            AbstractFile *af = arena->find(id);
+            if (af && af->getName() == oldname && tree->isAncestorOf(af)){
+                af->setName(name);
+                searchIndex->rename(af);
+                history->rename(af);
+                nodeChanged(af);
+            }
+        }
+        // the header shows the package name
+        emit headerDataChanged(Qt::Horizontal, 0, 0);
+    }
 }
 
 void TreePackageDragDropModel::createFolder(const QModelIndex &index)
@@ -424,10 +587,9 @@ void TreePackageDragDropModel::createFolder(const QModelIndex &index)
     if (index.isValid()){
         AbstractFile *af = static_cast<AbstractFile*>(index.internalPointer());
         // only if it's folder
-        if (Folder *f = dynamic_cast<Folder*>(af)){
-            beginInsertRows(index, f->count(false), f->count(false));
-            f->add(new Folder("new_folder", true));
-            endInsertRows();
+        if (Folder *f = af->toFolder()){
+            checkpoint();
+            appendFolder(f, "new_folder");
         }
     }
 }
@@ -437,30 +599,85 @@ void TreePackageDragDropModel::removeFolder(const QModelIndex &index)
     if (index.isValid()){
         AbstractFile *af = static_cast<AbstractFile*>(index.internalPointer());
         // only if it's folder
-        if (Folder *f = dynamic_cast<Folder*>(af)){
-            Folder *fparent = static_cast<Folder*>(index.parent().internalPointer());
-            beginRemoveRows(index.parent(), index.row(), index.row());
-            if (fparent->remove(f, false))
-                delete f;
-            endRemoveRows();
+        if (Folder *f = af->toFolder()){
+            checkpoint();
+            emit nodeRemoved(f->getId());
+            history->remove(f);
+            Folder *fparent = f->getParent()->toFolder();
+            bool removed = beginRemoveChild(f);
+            if (fparent->remove(f, false)){
+                searchIndex->remove(f);
+                forgetSubtree(f);
+                arena->destroy(f);
+            }
+            endRemoveChild(fparent, removed);
+            emit headerDataChanged(Qt::Horizontal, 0, 0);
         }
     }
 }
 
-QVariant TreePackageDragDropModel::displayRole(const QModelIndex &index) const
+quint64 TreePackageDragDropModel::addFolder(quint64 parent, const QString &name, bool canRename)
 {
-    QString ret = QString(static_cast<AbstractFile*>(index.internalPointer())->getName().c_str());
+    // the folders created by the user can have the same name,
+    // the ones of the package are found or created by name
+    quint64 ret = 0;
+    AbstractFile *af = arena->find(parent);
+    if (af && af->isFolder() && (af == tree || tree->isAncestorOf(af)) && !name.isEmpty()){
+        Folder *f = af->toFolder();
+        QStringList sl = QString(tree->pathOf(f).c_str()).split("/");
+        sl.removeAll(QString());
+        sl.append(name);
+        Folder *nf;
+        if (canRename && !isPackageFolder(sl, sl.size()-1, tree->getDisplayName())){
+            checkpoint();
+            nf = appendFolder(f, name.toStdString());
+        } else {
+            nf = ensureFolder(name, f);
+        }
+        ret = nf->getId();
+    }
     return ret;
 }
 
+void TreePackageDragDropModel::removeNode(quint64 id)
+{
+    AbstractFile *af = arena->find(id);
+    if (af && af->isFolder() && af->getParent() != tree && tree->isAncestorOf(af))
+        removeFolder(indexByAbstractFile(af));
+}
+
+void TreePackageDragDropModel::moveNode(quint64 id, quint64 folder)
+{
+    AbstractFile *af = arena->find(id);
+    AbstractFile *f = arena->find(folder);
+    if (af && af->toRealFile() && tree->isAncestorOf(af) && f && f->isFolder() && (f == tree || tree->isAncestorOf(f))){
+        checkpoint();
+        moveFile(af->toRealFile(), f->toFolder());
+    }
+}
+
+void TreePackageDragDropModel::renameNode(quint64 id, const QString &name)
+{
+    AbstractFile *af = arena->find(id);
+    if (af && tree->isAncestorOf(af))
+        setData(indexByAbstractFile(af), name, Qt::EditRole);
+}
+
+QVariant TreePackageDragDropModel::displayRole(const QModelIndex &index) const
+{
+    // the name is converted once, no allocation here
+    return static_cast<AbstractFile*>(index.internalPointer())->getDisplayName();
+}
+
 QVariant TreePackageDragDropModel::decorationRole(const QModelIndex &index) const
 {
+    static const QIcon folderIcon("://icon/folder.png");
     QIcon ret;
     AbstractFile *af = static_cast<AbstractFile*>(index.internalPointer());
-    if(dynamic_cast<Folder*>(af)) {
-        ret = QIcon("://icon/folder.png");
+    if (RealFile *rf = af->toRealFile()){
+        ret = rf->getFileSignatureInfo().getIcon();
     } else {
-        ret = dynamic_cast<RealFile*>(af)->getFileSignatureInfo().getIcon();
+        ret = folderIcon;
     }
     return ret;
 }
@@ -469,9 +686,9 @@ QVariant TreePackageDragDropModel::toolTipRole(const QModelIndex &index) const
 {
     QString ret;
     AbstractFile *af = static_cast<AbstractFile*>(index.internalPointer());
-    if (RealFile *rf = dynamic_cast<RealFile*>(af)){
-        FileSignatureInfo fi = rf->getFileSignatureInfo();
-        ret = "<b>[File]</b> " + QString(af->getName().c_str()) + "<br>";
+    if (RealFile *rf = af->toRealFile()){
+        FileSignatureInfo &fi = rf->getFileSignatureInfo();
+        ret = "<b>[File]</b> " + af->getDisplayName() + "<br>";
         if (fi.getCategory() == FileSignatureInfo::INEXISTANT){
             ret += "From: <i>debpac</i>";
         } else {
@@ -479,7 +696,386 @@ QVariant TreePackageDragDropModel::toolTipRole(const QModelIndex &index) const
             ret += "Magic number: <i>" + QString("%1 (%2)").arg(fi.getHex_signature().c_str(), fi.getExtension().c_str()) + "</i>";
         }
     } else {
-        ret = "<b>[Folder]</b> "+QString(af->getName().c_str());
+        ret = "<b>[Folder]</b> "+af->getDisplayName();
+    }
+    return ret;
+}
+
+Folder *TreePackageDragDropModel::createSkeleton(NodeArena *arena, const std::string &name)
+{
+    // default tree of a debian package
+    Folder *ret = arena->createFolder(name);
+    ret->add(arena->createFolder("DEBIAN", false)).add(arena->createFile("control", false));
+    ret->add(arena->createFolder("usr", false)).add(arena->createFolder("bin", false));
+    return ret;
+}
+
+bool TreePackageDragDropModel::isPackageFolder(const QStringList &segments, int idx, const QString &packageName)
+{
+    // only "usr/share/<package name>" can be renamed by the user
+    return idx == 2 && segments.size() > 2 && segments.at(0) == "usr" && segments.at(1) == "share" && segments.at(2) == packageName;
+}
+
+void TreePackageDragDropModel::createDefaultTree()
+{
+    tree = createSkeleton(arena, "packagename");
+    indexTree();
+}
+
+void TreePackageDragDropModel::indexTree()
+{
+    struct Indexer : public AbstractFileVisitor
+    {
+        SearchIndex *index;
+        bool visit(Folder *f) { index->insert(f); return true; }
+        void visit(RealFile *rf) { index->insert(rf); }
+    } indexer;
+    indexer.index = searchIndex;
+    tree->traverse(indexer);
+    // DEBIAN is edited with the tabs, it has no undo
+    history->reset(PersistentTree::build(tree));
+    history->remove(tree->getChild<Folder*>("DEBIAN"));
+}
+
+Folder *TreePackageDragDropModel::ensureFolder(const QString &path, Folder *from)
+{
+    // the whole path often already exist, no need to walk it
+    Folder *f = (from && from != tree) ? Q_NULLPTR : tree->findFolder(path.toStdString());
+    if (!f){
+        f = from ? from : tree;
+        // the package folders are known by their path from the root
+        QStringList sl = QString(tree->pathOf(f).c_str()).split("/");
+        sl.removeAll(QString());
+        const int depth = sl.size();
+        sl.append(path.split("/"));
+        // the empty parts of "a//b" or "/a/"
+        sl.removeAll(QString());
+        for (int idx=depth; idx<sl.size(); idx++){
+            if (Folder *current = f->getChild<Folder*>(sl.at(idx).toStdString())){
+                f = current;
+            } else {
+                int added = beginAppendRows(f, 1);
+                const bool packageFolder = isPackageFolder(sl, idx, tree->getDisplayName());
+                Folder *nf = arena->createFolder(sl.at(idx).toStdString(), packageFolder);
+                if (packageFolder)
+                    packageFolders.insert(nf->getId());
+                f->add(nf);
+                searchIndex->insert(nf);
+                history->add(f, std::vector<AbstractFile*>(1, nf));
+                endAppendRows(f, added);
+                emit folderAdded(nf->getId(), f->getId(), tree->pathOf(nf).c_str(), packageFolder);
+                f = nf;
+            }
+        }
+    }
+    return f;
+}
+
+Folder *TreePackageDragDropModel::appendFolder(Folder *parent, const std::string &name)
+{
+    int added = beginAppendRows(parent, 1);
+    Folder *nf = arena->createFolder(name, true);
+    parent->add(nf);
+    searchIndex->insert(nf);
+    history->add(parent, std::vector<AbstractFile*>(1, nf));
+    endAppendRows(parent, added);
+    emit folderAdded(nf->getId(), parent->getId(), tree->pathOf(nf).c_str(), true);
+    return nf;
+}
+
+void TreePackageDragDropModel::moveFile(RealFile *rf, Folder *folder)
+{
+    history->remove(rf);
+    Folder *old = rf->getParent()->toFolder();
+    bool removed = beginRemoveChild(rf);
+    old->remove(rf, false);
+    endRemoveChild(old, removed);
+    int added = beginAppendRows(folder, 1);
+    folder->add(rf);
+    history->add(folder, std::vector<AbstractFile*>(1, rf));
+    endAppendRows(folder, added);
+    emit nodeMoved(rf->getId(), folder->getId());
+}
+
+void TreePackageDragDropModel::forgetSubtree(AbstractFile *af)
+{
+    // the files of a removed folder must not be generated or saved,
+    // and the fetched rows of its folders must not be reused by the
+    // nodes that will be created at the same address
+    struct Collector : public AbstractFileVisitor
+    {
+        QSet<RealFile*> files;
+        QHash<const Folder*, int> *loaded;
+        bool visit(Folder *f) { loaded->remove(f); return true; }
+        void visit(RealFile *rf) { files.insert(rf); }
+    } collector;
+    collector.loaded = &loaded;
+    af->accept(collector);
+    if (Folder *f = af->toFolder())
+        f->traverse(collector);
+    if (!collector.files.isEmpty()){
+        auto removed = [&collector](RealFile *rf){ return collector.files.contains(rf); };
+        fileFromUser.erase(std::remove_if(fileFromUser.begin(), fileFromUser.end(), removed), fileFromUser.end());
+        fileFromProgram.erase(std::remove_if(fileFromProgram.begin(), fileFromProgram.end(), removed), fileFromProgram.end());
+    }
+}
+
+Folder *TreePackageDragDropModel::folderAt(const QModelIndex &index) const
+{
+    Folder *ret = tree; // root
+    if (index.isValid())
+        ret = static_cast<AbstractFile*>(index.internalPointer())->toFolder();
+    return ret;
+}
+
+int TreePackageDragDropModel::loadedRows(Folder *f) const
+{
+    auto it = loaded.find(f);
+    if (it == loaded.end())
+        it = loaded.insert(f, qMin(f->count(false), FETCH_BATCH));
+    return it.value();
+}
+
+bool TreePackageDragDropModel::isExposed(AbstractFile *af) const
+{
+    // all the rows from the root to af are known by the view
+    bool ret = true;
+    while (ret && af != tree){
+        AbstractFile *parent = af->getParent();
+        auto it = loaded.find(parent->toFolder());
+        ret = it != loaded.end() && af->getRow() < it.value();
+        af = parent;
+    }
+    return ret;
+}
+
+int TreePackageDragDropModel::beginAppendRows(Folder *f, int count)
+{
+    // rows appended behind rows not fetched yet will be fetched later,
+    // a folder never queried by the view has nothing to announce
+    int ret = 0;
+    auto it = loaded.find(f);
+    if (it != loaded.end() && it.value() == f->count(false)){
+        ret = qMin(count, FETCH_BATCH);
+        if (ret > 0)
+            beginInsertRows(indexByAbstractFile(f), it.value(), it.value()+ret-1);
+    }
+    return ret;
+}
+
+void TreePackageDragDropModel::endAppendRows(Folder *f, int added)
+{
+    if (added > 0){
+        loaded[f] += added;
+        endInsertRows();
+    } else if (f != tree && !loaded.contains(f) && isExposed(f)){
+        // its first rows are loaded by rowCount(), the view only has
+        // to learn that the folder may have children now
+        QModelIndex index = indexByAbstractFile(f);
+        emit dataChanged(index, index);
+    }
+}
+
+bool TreePackageDragDropModel::beginRemoveChild(AbstractFile *af)
+{
+    bool ret = false;
+    auto it = loaded.find(af->getParent()->toFolder());
+    if (it != loaded.end() && af->getRow() < it.value()){
+        QModelIndex index = indexByAbstractFile(af);
+        beginRemoveRows(index.parent(), index.row(), index.row());
+        ret = true;
+    }
+    return ret;
+}
+
+void TreePackageDragDropModel::endRemoveChild(Folder *parent, bool removed)
+{
+    if (removed){
+        loaded[parent]--;
+        endRemoveRows();
+    }
+}
+
+QModelIndex TreePackageDragDropModel::reveal(AbstractFile *af)
+{
+    // fetch, from the root, the rows needed to reach af
+    QVector<AbstractFile*> path;
+    for (AbstractFile *current = af; current != tree; current = current->getParent()){
+        path.prepend(current);
+    }
+    for (AbstractFile *current : path){
+        Folder *parent = current->getParent()->toFolder();
+        const int rows = loadedRows(parent);
+        if (current->getRow() >= rows){
+            beginInsertRows(indexByAbstractFile(parent), rows, current->getRow());
+            loaded[parent] = current->getRow()+1;
+            endInsertRows();
+        }
+    }
+    return indexByAbstractFile(af);
+}
+
+void TreePackageDragDropModel::clearState()
+{
+    // stop the running drops, their pending results will be ignored
+    for (FileScanner *scanner : findChildren<FileScanner*>()){
+        scanner->requestInterruption();
+    }
+    scan++;
+    loaded.clear();
+    fileFromUser.clear();
+    fileFromProgram.clear();
+    undoStack.clear();
+    redoStack.clear();
+    packageFolders.clear();
+}
+
+void TreePackageDragDropModel::nodeChanged(AbstractFile *af)
+{
+    // a row never given to the view has nothing to refresh
+    if (isExposed(af)){
+        QModelIndex index = indexByAbstractFile(af);
+        emit dataChanged(index, index);
+    }
+}
+
+void TreePackageDragDropModel::checkpoint()
+{
+    // the snapshot shares all its nodes with the current tree
+    undoStack.append(history->snapshot());
+    redoStack.clear();
+    emit undoAvailable(true);
+    emit redoAvailable(false);
+}
+
+void TreePackageDragDropModel::restoreSnapshot(const PersistentTree::NodePtr &target)
+{
+    // only the folders that differ between the snapshots are visited
+    SyncState state;
+    syncFolder(tree, history->snapshot(), target, state);
+    for (AbstractFile *af : state.detached){
+        searchIndex->remove(af);
+        forgetSubtree(af);
+        arena->destroy(af);
+    }
+    history->reset(target);
+    // the nodes kept for the program are mirrored again, without its files
+    for (AbstractFile *af : state.kept){
+        history->add(af->getParent()->toFolder(), std::vector<AbstractFile*>(1, af));
+        for (RealFile *rf : fileFromProgram){
+            if (rf == af || (af->isFolder() && af->toFolder()->isAncestorOf(rf)))
+                history->remove(rf);
+        }
+    }
+    for (AbstractFile *af : state.renamed){
+        history->rename(af);
+    }
+    emit headerDataChanged(Qt::Horizontal, 0, 0);
+}
+
+void TreePackageDragDropModel::syncFolder(Folder *live, const PersistentTree::NodePtr &from, const PersistentTree::NodePtr &to, SyncState &state)
+{
+    if (from != to){
+        // looked up by id, a wide folder would be compared child by child
+        QSet<quint64> kept;
+        kept.reserve(int(to->children.size()));
+        for (const PersistentTree::NodePtr &c : to->children)
+            kept.insert(c->id);
+        QHash<quint64, PersistentTree::NodePtr> previous;
+        previous.reserve(int(from->children.size()));
+        for (const PersistentTree::NodePtr &c : from->children)
+            previous.insert(c->id, c);
+        for (const PersistentTree::NodePtr &c : from->children){
+            AbstractFile *af = arena->find(c->id);
+            if (!kept.contains(c->id) && af && af->getParent() == live){
+                if (holdsProgramFile(af)){
+                    state.kept.append(af);
+                } else {
+                    detach(af);
+                    state.detached.insert(c->id, af);
+                }
+            }
+        }
+        for (const PersistentTree::NodePtr &c : to->children){
+            PersistentTree::NodePtr old = previous.value(c->id);
+            AbstractFile *af = arena->find(c->id);
+            if (old && af && af->getParent() == live){
+                if (af->getName() != c->name.str()){
+                    // the package folders follow the control file
+                    if (af->getName() == tree->getName()){
+                        state.renamed.append(af);
+                    } else {
+                        af->setName(c->name.str());
+                        searchIndex->rename(af);
+                        nodeChanged(af);
+                    }
+                }
+                if (Folder *f = af->toFolder())
+                    syncFolder(f, old, c, state);
+            } else {
+                if (af && af->getParent()){
+                    // moved here, from a folder not visited yet
+                    detach(af);
+                } else if (!af){
+                    af = createFromSnapshot(c);
+                }
+                state.detached.remove(c->id);
+                attach(live, af);
+            }
+        }
+    }
+}
+
+AbstractFile *TreePackageDragDropModel::createFromSnapshot(const PersistentTree::NodePtr &node)
+{
+    AbstractFile *ret;
+    if (node->folder){
+        Folder *f = arena->createFolder(node->name.str(), node->canRename, node->id);
+        for (const PersistentTree::NodePtr &c : node->children){
+            AbstractFile *af = createFromSnapshot(c);
+            if (Folder *cf = af->toFolder())
+                f->add(cf);
+            else
+                f->add(af->toRealFile());
+        }
+        ret = f;
+    } else {
+        // the signature was kept by the snapshot, no file is read
+        FileSignatureInfo *fsi = node->info ? arena->createFileSignatureInfo(*node->info) : Q_NULLPTR;
+        RealFile *rf = arena->createFile(node->name.str(), node->canRename, fsi, node->id);
+        rf->setMode(node->mode);
+        if (fsi)
+            fileFromUser.append(rf);
+        ret = rf;
+    }
+    searchIndex->insert(ret);
+    return ret;
+}
+
+bool TreePackageDragDropModel::holdsProgramFile(AbstractFile *af)
+{
+    bool ret = false;
+    Folder *f = af->toFolder();
+    for (int i=0; i<fileFromProgram.size() && !ret; i++){
+        ret = fileFromProgram.at(i) == af || (f && f->isAncestorOf(fileFromProgram.at(i)));
     }
     return ret;
 }
+
+void TreePackageDragDropModel::detach(AbstractFile *af)
+{
+    Folder *parent = af->getParent()->toFolder();
+    bool removed = beginRemoveChild(af);
+    parent->remove(af, false);
+    endRemoveChild(parent, removed);
+}
+
+void TreePackageDragDropModel::attach(Folder *f, AbstractFile *af)
+{
+    int added = beginAppendRows(f, 1);
+    if (Folder *child = af->toFolder())
+        f->add(child);
+    else
+        f->add(af->toRealFile());
+    endAppendRows(f, added);
+}
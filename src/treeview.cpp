@@ -5,39 +5,107 @@
 #include "folder.h"
 #include <QMenu>
 #include <QContextMenuEvent>
+#include <QItemSelection>
+
+namespace {
+// hits revealed and selected in the tree
+const int MAX_MATCHES = 100;
+}
 
 TreeView::TreeView(QWidget *parent)
     : QTreeView(parent)
 {
     actionCreateFolder = new QAction("Create folder", this);
     actionRemoveFolder = new QAction("Remove folder", this);
+    actionUndo = new QAction("Undo", this);
+    actionRedo = new QAction("Redo", this);
 
     actionCreateFolder->setShortcut(QKeySequence(Qt::CTRL | Qt::SHIFT | Qt::Key_N));
     actionRemoveFolder->setShortcut(QKeySequence(Qt::CTRL | Qt::SHIFT | Qt::Key_R));
+    // only in the tree, the editors have their own undo
+    actionUndo->setShortcut(QKeySequence::Undo);
+    actionRedo->setShortcut(QKeySequence::Redo);
+    actionUndo->setShortcutContext(Qt::WidgetShortcut);
+    actionRedo->setShortcutContext(Qt::WidgetShortcut);
+    actionUndo->setEnabled(false);
+    actionRedo->setEnabled(false);
 
     addAction(actionCreateFolder);
     addAction(actionRemoveFolder);
+    addAction(actionUndo);
+    addAction(actionRedo);
 
+    currentMatch = 0;
     tp_model = new TreePackageDragDropModel(this);
     setModel(tp_model);
-    expandAll();
+    // the rows are fetched by batch and have the same height,
+    // so the view never needs to load or measure the whole tree
+    setUniformRowHeights(true);
+    expandDefault();
     setAcceptDrops(true);
     setDragEnabled(true);
 
     connect(actionCreateFolder, SIGNAL(triggered(bool)), this, SLOT(createFolder()));
     connect(actionRemoveFolder, SIGNAL(triggered(bool)), this, SLOT(removeFolder()));
+    connect(tp_model, SIGNAL(modelReset()), this, SLOT(expandDefault()));
+    connect(actionUndo, SIGNAL(triggered(bool)), tp_model, SLOT(undo()));
+    connect(actionRedo, SIGNAL(triggered(bool)), tp_model, SLOT(redo()));
+    connect(tp_model, SIGNAL(undoAvailable(bool)), actionUndo, SLOT(setEnabled(bool)));
+    connect(tp_model, SIGNAL(redoAvailable(bool)), actionRedo, SLOT(setEnabled(bool)));
 }
 
 TreeView::~TreeView()
 {
     delete actionCreateFolder;
     delete actionRemoveFolder;
+    delete actionUndo;
+    delete actionRedo;
     delete tp_model;
 }
 
-void TreeView::addFile(FileSignatureInfo *fsi)
+void TreeView::expandDefault()
+{
+    // the package skeleton (DEBIAN, usr, ...) is shown, not what was dropped in it
+    expandToDepth(1);
+}
+
+void TreeView::search(const QString &text)
+{
+    // the hits come from the model index, only their ancestors are expanded
+    matches.clear();
+    currentMatch = 0;
+    QItemSelection selection;
+    if (!text.trimmed().isEmpty()){
+        for (const QModelIndex &index : tp_model->find(text, MAX_MATCHES)){
+            matches.append(index);
+            selection.select(index, index);
+            for (QModelIndex parent = index.parent(); parent.isValid(); parent = parent.parent()){
+                expand(parent);
+            }
+        }
+    }
+    selectionModel()->select(selection, QItemSelectionModel::ClearAndSelect | QItemSelectionModel::Rows);
+    if (!matches.isEmpty()){
+        selectionModel()->setCurrentIndex(matches.first(), QItemSelectionModel::NoUpdate);
+        scrollTo(matches.first());
+    }
+}
+
+void TreeView::nextMatch()
+{
+    if (!matches.isEmpty()){
+        currentMatch = (currentMatch+1) % matches.size();
+        const QModelIndex index = matches.at(currentMatch);
+        if (index.isValid()){
+            selectionModel()->setCurrentIndex(index, QItemSelectionModel::NoUpdate);
+            scrollTo(index);
+        }
+    }
+}
+
+void TreeView::addFile(const FileSignatureInfo &info)
 {
-    tp_model->addFileInfo(fsi);
+    tp_model->addFileInfo(info);
 }
 
 void TreeView::createFolder()
@@ -58,7 +126,7 @@ void TreeView::contextMenuEvent(QContextMenuEvent *event)
     QModelIndex index = indexAt(event->pos());
     if (index.isValid()){
         AbstractFile *af = static_cast<AbstractFile*>(index.internalPointer());
-        if (af->getName() != "DEBIAN" && af->getParent()->getName() != "DEBIAN" && dynamic_cast<Folder*>(af)){
+        if (af->getName() != "DEBIAN" && af->getParent()->getName() != "DEBIAN" && af->isFolder()){
             // you can't touch DEBIAN folder
             QMenu menu(this);
             menu.addAction(actionCreateFolder);
@@ -66,6 +134,9 @@ void TreeView::contextMenuEvent(QContextMenuEvent *event)
                 // if is not DEBIAN or usr folder
                 menu.addAction(actionRemoveFolder);
             }
+            menu.addSeparator();
+            menu.addAction(actionUndo);
+            menu.addAction(actionRedo);
             menu.exec(event->globalPos());
         }
     }
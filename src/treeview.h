@@ -2,6 +2,7 @@
 #define TREEVIEW_H
 
 #include <QTreeView>
+#include <QPersistentModelIndex>
 
 class TreePackageDragDropModel;
 class FileSignatureInfo;
@@ -19,7 +20,10 @@ public:
     ~TreeView();
 
 public slots:
-    void addFile(FileSignatureInfo *fsi);
+    void expandDefault();
+    void search(const QString& text);
+    void nextMatch();
+    void addFile(const FileSignatureInfo &info);
     void createFolder();
     void removeFolder();
 
@@ -30,6 +34,10 @@ private:
     TreePackageDragDropModel *tp_model;
     QAction *actionCreateFolder;
     QAction *actionRemoveFolder;
+    QAction *actionUndo;
+    QAction *actionRedo;
+    QList<QPersistentModelIndex> matches;
+    int currentMatch;
 
 };
 